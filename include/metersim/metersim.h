@@ -29,6 +29,103 @@ metersim_ctx_t *metersim_init(const char *dir);
 void metersim_free(metersim_ctx_t *ctx);
 
 
+/*
+ * Save the state of the simulation (time, registers, position in the updates file, speedup) to `path`.
+ * Devices are not saved and have to be created again after loading. Returns status code.
+ */
+int metersim_saveState(metersim_ctx_t *ctx, const char *path);
+
+
+/*
+ * Create the simulator from the scenario in `dir` and restore the state saved to `path`.
+ * The scenario must be the same as the one of the saved simulator. Returns NULL on failure.
+ */
+metersim_ctx_t *metersim_loadState(const char *dir, const char *path);
+
+
+/*
+ * Rewind the simulation to the beginning of the scenario with the initial registers, without any allocation.
+ * All devices are removed. Refused if the simulator has a runner. Returns status code.
+ */
+int metersim_reset(metersim_ctx_t *ctx);
+
+
+/*
+ * Create an independent copy of the simulator at its current time. The updates of the scenario are
+ * shared, the registers and the rest of the state are copied. The clone has no runner. Devices are
+ * copied with the same callbacks and callback contexts, watchpoints and subscriptions are not copied. Returns NULL on failure.
+ */
+metersim_ctx_t *metersim_clone(metersim_ctx_t *ctx);
+
+
+/* INSTANCE POOL */
+
+/* Pool of simulators of the same scenario */
+typedef struct metersim_pool_s metersim_pool_t;
+
+
+/*
+ * Create a pool of `size` simulators of the scenario in `dir`. The scenario is parsed only once,
+ * the other instances are its clones. Returns NULL on failure.
+ */
+metersim_pool_t *metersim_poolInit(const char *dir, size_t size);
+
+
+/* Release the pool and all its simulators, including the ones not given back */
+void metersim_poolFree(metersim_pool_t *pool);
+
+
+/* Take a simulator at the beginning of the scenario from the pool. Returns NULL if none is available. */
+metersim_ctx_t *metersim_poolAcquire(metersim_pool_t *pool);
+
+
+/* Give the simulator back to the pool. Its runner is destroyed and the simulation is reset. */
+void metersim_poolRelease(metersim_pool_t *pool, metersim_ctx_t *ctx);
+
+
+/* MANUAL CLOCK */
+
+/* Clock which moves only when advanced explicitly, for runners in tests which should not sleep */
+typedef struct metersim_clock_s metersim_clock_t;
+
+
+/* Create a manual clock standing at 0. Returns NULL on failure. */
+metersim_clock_t *metersim_clockInit(void);
+
+
+/* Release the clock. The runners and groups using it have to be destroyed before. */
+void metersim_clockFree(metersim_clock_t *clock);
+
+
+/*
+ * Move the clock forward by `nsec` nanoseconds and wake up the runners using it. They process the passed time
+ * in their threads, accessing a simulator waits until its runner has caught up. Lazy runners catch up on their
+ * next access as usual. Returns status code.
+ */
+int metersim_clockAdvance(metersim_clock_t *clock, int64_t nsec);
+
+
+/* RUNNER GROUP */
+
+/* One thread driving the runners of many simulators on a common clock */
+typedef struct metersim_group_s metersim_group_t;
+
+
+/*
+ * Create a group with its clock running from 0 with `speedup`. The clock follows `clock`, or the system
+ * monotonic clock if it is NULL. Returns NULL on failure.
+ */
+metersim_group_t *metersim_groupInit(uint16_t speedup, metersim_clock_t *clock);
+
+
+/* Release the group. Refused while any runner of the group exists. Returns status code. */
+int metersim_groupFree(metersim_group_t *group);
+
+
+/* Set the speedup of the clock of the group. Returns status code. */
+int metersim_groupSetSpeedup(metersim_group_t *group, uint16_t speedup);
+
+
 /* SIMULATION WITH RUNNER */
 
 /*
@@ -38,6 +135,15 @@ void metersim_free(metersim_ctx_t *ctx);
 int metersim_createRunner(metersim_ctx_t *ctx, int start);
 
 
+/*
+ * Create simulation runner like metersim_createRunner, with its thread configured by `opts`: bound to a CPU,
+ * scheduled with a real-time policy and with the memory of the process locked. Locking the memory applies to
+ * the whole process and is not undone when the runner is destroyed, only if the runner fails to start.
+ * Returns status code, error also if the system does not permit the options.
+ */
+int metersim_createRunnerWithOpts(metersim_ctx_t *ctx, int start, const metersim_runnerOpts_t *opts);
+
+
 /*
  * Create simulation runner with custom getTimeCb. Returns status code.
  * The callback should return the UTC time.
@@ -45,6 +151,46 @@ int metersim_createRunner(metersim_ctx_t *ctx, int start);
 int metersim_createRunnerWithCb(metersim_ctx_t *ctx, uint64_t (*getTimeCb)(void *), void *args);
 
 
+/*
+ * Create simulation runner without a background thread. Returns status code.
+ * The clock runs like in metersim_createRunner, but the simulation catches up with it only when
+ * the simulator is accessed, in the calling thread. Devices and watchpoint callbacks are called then,
+ * at their simulated time. `start` has the same meaning as in metersim_createRunner.
+ */
+int metersim_createLazyRunner(metersim_ctx_t *ctx, int start);
+
+
+/* Create lazy runner like metersim_createLazyRunner, with its clock following the manual `clock`. Returns status code. */
+int metersim_createLazyRunnerWithClock(metersim_ctx_t *ctx, int start, metersim_clock_t *clock);
+
+
+/*
+ * Create simulation runner driven by an external clock which pushes the time with metersim_advanceTime,
+ * without a thread or polling. `nowUtc` is the UTC time of the current moment of the simulation.
+ * The runner cannot be paused, resumed or sped up, and metersim_stepForward is refused while it exists.
+ * Returns status code, refused if the simulator has a watchpoint without callback.
+ */
+int metersim_createPushedRunner(metersim_ctx_t *ctx, int64_t nowUtc);
+
+
+/*
+ * Advance the simulation of a pushed runner to `utc`. The UTC time of the next event of the simulation
+ * (update, device wakeup, register boundary, watchpoint) is written to `nextUtc`, or -1 if there is none.
+ * Pushing the time earlier than that changes nothing. Returns status code, error if the time goes back.
+ */
+int metersim_advanceTime(metersim_ctx_t *ctx, int64_t utc, int64_t *nextUtc);
+
+
+/*
+ * Create simulation runner driven by the thread of `group`. The simulation is stepped to the time of the clock
+ * of the group, which must not be behind the simulator, and follows it from then on. The speedup is set for
+ * the whole group with metersim_groupSetSpeedup. metersim_pause, metersim_resume and metersim_setSpeedup
+ * are refused, as is metersim_stepForward while the runner exists. Returns status code, refused if the
+ * simulator has a watchpoint without callback.
+ */
+int metersim_createGroupRunner(metersim_ctx_t *ctx, metersim_group_t *group);
+
+
 /*
  * Release runner resources
  * (Function stops the runner if it is still running)
@@ -52,28 +198,77 @@ int metersim_createRunnerWithCb(metersim_ctx_t *ctx, uint64_t (*getTimeCb)(void
 void metersim_destroyRunner(metersim_ctx_t *ctx);
 
 
-/* Resume the runner. Returns status code. */
+/* Resume the runner. Returns status code, refused for a pushed or group runner. */
 int metersim_resume(metersim_ctx_t *ctx);
 
 
-/* Stop the runner. Returns status code. */
+/* Stop the runner. Returns status code, refused for a pushed or group runner. */
 int metersim_pause(metersim_ctx_t *ctx, int32_t when);
 
 
+/*
+ * Add a watchpoint on the condition `type` (METERSIM_WATCH_*) with `threshold`. The watchpoint triggers at the
+ * exact second at which the condition becomes true. Without `callback` the runner pauses there, as if
+ * metersim_pause was called for that moment. Otherwise `callback(id, uptime, callbackCtx)` is called from
+ * the simulation thread and must not call the API of this simulator. Callbacks also work while stepping
+ * forward without runner. A pushed or group runner cannot be paused, so a watchpoint without callback
+ * is refused there. Returns nonnegative id of the watchpoint, or status code on error.
+ */
+int metersim_addWatchpoint(metersim_ctx_t *ctx, int type, double threshold, void (*callback)(int, int32_t, void *), void *callbackCtx);
+
+
+/* Remove the watchpoint with given id. Returns status code. */
+int metersim_removeWatchpoint(metersim_ctx_t *ctx, int id);
+
+
+/*
+ * Subscribe to changes of the quantities `fields` (METERSIM_NOTIFY_*) beyond `deadband`, measured from their values
+ * at the last notification. `callback(id, changed, uptime, callbackCtx)` is called with the quantities which left
+ * their deadbands, from the simulation thread like watchpoint callbacks. Returns nonnegative id of the subscription,
+ * or status code on error.
+ */
+int metersim_subscribe(metersim_ctx_t *ctx, unsigned int fields, const metersim_deadband_t *deadband,
+	void (*callback)(int, unsigned int, int32_t, void *), void *callbackCtx);
+
+
+/*
+ * Subscribe like metersim_subscribe, but notify by writing a 64-bit 1 to `fd`, e.g. an eventfd, a pipe or a socket,
+ * which the application can wait on. `fd` has to be in O_NONBLOCK mode, notifications are dropped while it is full.
+ * A closed reader does not raise SIGPIPE. Returns nonnegative id of the subscription, or status code on error.
+ */
+int metersim_subscribeFd(metersim_ctx_t *ctx, unsigned int fields, const metersim_deadband_t *deadband, int fd);
+
+
+/* Remove the subscription with given id. Returns status code. */
+int metersim_unsubscribe(metersim_ctx_t *ctx, int id);
+
+
 /* Check whether runner is running. Returns status code. */
 int metersim_isRunning(metersim_ctx_t *ctx);
 
 
-/* Set runner speedup. Returns status code. */
+/* Set runner speedup. Returns status code, refused for a pushed or group runner. */
 int metersim_setSpeedup(metersim_ctx_t *ctx, uint16_t speedup);
 
 
+/* Get the histogram of runner latencies of `kind` (METERSIM_LATENCY_*) since the runner was created. Returns status code. */
+int metersim_getLatency(metersim_ctx_t *ctx, int kind, metersim_latency_t *ret);
+
+
 /* SIMULATION WITHOUT RUNNER */
 
 /* Simulate the passage of time */
 int metersim_stepForward(metersim_ctx_t *ctx, uint32_t seconds);
 
 
+/*
+ * Simulate the passage of time, taking a sample of the groups selected in `fields` every `interval` seconds.
+ * Samples are written to `buf`, which has to fit at least `seconds / interval` of them (`n` is its capacity).
+ * Returns number of samples written, or status code on error.
+ */
+int metersim_stepAndSample(metersim_ctx_t *ctx, uint32_t seconds, uint32_t interval, unsigned int fields, metersim_sample_t *buf, size_t n);
+
+
 /* DEVICES API */
 
 /* Create new device by providing callback and its context. Returns nonnegative id of the created device, or -1 on error. */
@@ -114,6 +309,10 @@ void metersim_setTimeUTC(metersim_ctx_t *ctx, int64_t time);
 void metersim_getUptime(metersim_ctx_t *ctx, int32_t *retSeconds);
 
 
+/* Get the absolute timestamp of uptime 0, i.e. the current UTC time minus the uptime, taken at once */
+void metersim_getStartTimeUTC(metersim_ctx_t *ctx, int64_t *retTime);
+
+
 /* Get number of phases */
 void metersim_getPhaseCount(metersim_ctx_t *ctx, int *retCount);
 
@@ -138,6 +337,61 @@ void metersim_getEnergyTotal(metersim_ctx_t *ctx, metersim_energy_t *ret);
 int metersim_getEnergyTariff(metersim_ctx_t *ctx, metersim_energy_t ret[3], int idxTariff);
 
 
+/* Get demand registers of the tariff (average active power over the demand window). Returns status code. */
+int metersim_getDemand(metersim_ctx_t *ctx, metersim_demand_t *ret, int idxTariff);
+
+
+/*
+ * Get load profile entries with timestamps (uptime) in range [from, to].
+ * At most `n` entries are copied to `buf`. Returns the number of copied entries.
+ */
+size_t metersim_getLoadProfile(metersim_ctx_t *ctx, int32_t from, int32_t to, metersim_profileEntry_t *buf, size_t n);
+
+
+/*
+ * Get the recorded changes of the quantity `field` (METERSIM_HISTORY_*) with timestamps (uptime) in range [from, to].
+ * The value holds until the next point. Points older than `historyRetention` seconds may be dropped.
+ * At most `n` points are copied to `buf`. Returns the number of copied points, or status code on error.
+ */
+int metersim_queryHistory(metersim_ctx_t *ctx, int field, int32_t from, int32_t to, metersim_historyPoint_t *buf, size_t n);
+
+
+/*
+ * Get statistics (min, max, mean, 95th percentile) of voltage, frequency and THD
+ * over the last completed window of type `window` (METERSIM_PQ_WINDOW_*).
+ * Windows are aligned to uptime. Returns METERSIM_ERROR if the window type is invalid.
+ */
+int metersim_getPqStats(metersim_ctx_t *ctx, metersim_pqStats_t *ret, int window);
+
+
+/*
+ * Synthesize the next block of METERSIM_WAVEFORM_BLOCK samples of voltage and current waveforms
+ * from the current phasors and THD. Sample stream is continuous between calls.
+ * `ret` points to buffers owned by the simulator, valid until the next call or metersim_free.
+ * A single reader per instance is required, as the next call overwrites the samples of the previous block.
+ * Returns METERSIM_ERROR if `waveformSampleRate` is not configured.
+ */
+int metersim_readWaveform(metersim_ctx_t *ctx, metersim_waveform_t *ret);
+
+
+/*
+ * Read and remove up to `n` power quality events from the event log to `buf`.
+ * Each event is reported when it starts (with end set to METERSIM_PQ_EVENT_ONGOING) and when it ends.
+ * Events are dropped if the log is full. Returns the number of read events.
+ * Reading does not block the simulation and can be done from several threads.
+ */
+size_t metersim_readPqEvents(metersim_ctx_t *ctx, metersim_pqEvent_t *buf, size_t n);
+
+
+/*
+ * Read and remove up to `n` pulses of the pulse output to `buf`. A pulse is emitted every `meterConstant`
+ * Ws (or vars) on each channel, timestamps are exact. Requires `pulseBufferSize` to be configured.
+ * Pulses are dropped if the buffer is full. Returns the number of read pulses.
+ * Reading does not block the simulation and can be done from several threads.
+ */
+size_t metersim_readPulses(metersim_ctx_t *ctx, metersim_pulse_t *buf, size_t n);
+
+
 /* Get power triangle (P, Q, S, phi angle) */
 void metersim_getPower(metersim_ctx_t *ctx, metersim_power_t *ret);
 
@@ -150,4 +404,8 @@ void metersim_getVector(metersim_ctx_t *ctx, metersim_vector_t *ret);
 void metersim_getThd(metersim_ctx_t *ctx, metersim_thd_t *ret);
 
 
+/* Get the groups of values selected by `fields` (METERSIM_SNAPSHOT_*), all taken at the same moment */
+void metersim_getSnapshot(metersim_ctx_t *ctx, unsigned int fields, metersim_snapshot_t *ret);
+
+
 #endif /* METERSIM_H */
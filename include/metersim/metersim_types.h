@@ -33,6 +33,13 @@
 #define METERSIM_MAX_THDU            ((double)1)
 #define METERSIM_MAX_THDI            ((double)1)
 #define METERSIM_MAX_FREQUENCY       ((double)1000) /* (Hz) */
+#define METERSIM_MAX_DEMAND_PERIOD   (24 * 3600) /* (s) */
+#define METERSIM_MAX_SUBPERIODS      15
+#define METERSIM_MAX_PROFILE_PERIOD  (24 * 3600) /* (s) */
+#define METERSIM_MAX_PROFILE_ENTRIES (1024 * 1024)
+#define METERSIM_MAX_SAMPLE_RATE     100000 /* (Hz) */
+#define METERSIM_MAX_PULSE_BUFFER    (1024 * 1024)
+#define METERSIM_MAX_HISTORY_RETENTION (31 * 24 * 3600) /* (s) */
 
 
 #define METERSIM_NO_UPDATE_SCHEDULED (INT32_MAX)
@@ -86,6 +93,209 @@ typedef struct {
 } metersim_thd_t;
 
 
+/* Indexes of the demand registers */
+#define METERSIM_DEMAND_IMPORT 0
+#define METERSIM_DEMAND_EXPORT 1
+
+
+typedef struct {
+	double last[2];     /* (W) average active power over the last completed demand window */
+	double max[2];      /* (W) maximum demand registered on the tariff */
+	int32_t maxTime[2]; /* (s) uptime at the end of the window with the maximum demand */
+} metersim_demand_t;
+
+
+typedef struct {
+	int32_t timestamp;        /* (s) uptime at the end of the capture period */
+	metersim_energy_t energy; /* energy registers grand total at the end of the period */
+	float frequency;          /* (Hz) averages over the period */
+	double voltage[3];        /* (V) */
+	double current[3];        /* (A) */
+} metersim_profileEntry_t;
+
+
+/* Types of power quality events */
+#define METERSIM_PQ_SAG          0
+#define METERSIM_PQ_SWELL        1
+#define METERSIM_PQ_INTERRUPTION 2
+#define METERSIM_PQ_PHASE_LOSS   3
+#define METERSIM_PQ_THD_U        4
+#define METERSIM_PQ_THD_I        5
+#define METERSIM_PQ_EVENT_TYPES  6
+
+#define METERSIM_PQ_EVENT_ONGOING (-1)
+#define METERSIM_PQ_ALL_PHASES    (-1)
+
+
+typedef struct {
+	uint8_t type;   /* METERSIM_PQ_* */
+	int8_t phase;   /* index of the phase or METERSIM_PQ_ALL_PHASES */
+	int32_t start;  /* (s) uptime at which the event started */
+	int32_t end;    /* (s) uptime at which the event ended or METERSIM_PQ_EVENT_ONGOING */
+	double extreme; /* lowest (sag, interruption, phase loss) or highest (swell, THD) value during the event */
+} metersim_pqEvent_t;
+
+
+/* Aggregation windows of power quality statistics */
+#define METERSIM_PQ_WINDOW_10MIN 0
+#define METERSIM_PQ_WINDOW_2H    1
+#define METERSIM_PQ_WINDOW_COUNT 2
+
+
+typedef struct {
+	double min;
+	double max;
+	double mean; /* time-weighted */
+	double p95;  /* 95th percentile of the time-weighted distribution (estimated) */
+} metersim_pqAggregate_t;
+
+
+typedef struct {
+	int32_t start; /* (s) uptime at the start of the window */
+	int32_t end;   /* (s) uptime at the end of the window, 0 if no window was completed yet */
+	metersim_pqAggregate_t voltage[3];
+	metersim_pqAggregate_t frequency;
+	metersim_pqAggregate_t thdU[3];
+	metersim_pqAggregate_t thdI[3];
+} metersim_pqStats_t;
+
+
+/* Number of samples in a block of synthesized waveform */
+#define METERSIM_WAVEFORM_BLOCK 256
+
+
+typedef struct {
+	uint32_t count;       /* number of samples per phase */
+	uint32_t sampleRate;  /* (Hz) */
+	uint64_t firstSample; /* index of the first sample in the stream */
+	const float *u[3];    /* (V) instantaneous voltage per phase */
+	const float *i[3];    /* (A) instantaneous current per phase */
+} metersim_waveform_t;
+
+
+/* Channels of the pulse output */
+#define METERSIM_PULSE_ACTIVE_PLUS     0
+#define METERSIM_PULSE_ACTIVE_MINUS    1
+#define METERSIM_PULSE_REACTIVE_PLUS   2
+#define METERSIM_PULSE_REACTIVE_MINUS  3
+#define METERSIM_PULSE_CHANNELS        4
+
+
+typedef struct {
+	double timestamp; /* (s) uptime of the pulse, with fraction of a second */
+	uint8_t channel;  /* METERSIM_PULSE_* */
+} metersim_pulse_t;
+
+
+/* Quantities recorded in the history */
+#define METERSIM_HISTORY_FREQUENCY      0
+#define METERSIM_HISTORY_VOLTAGE        1 /* + phase index */
+#define METERSIM_HISTORY_CURRENT        4 /* + phase index */
+#define METERSIM_HISTORY_ACTIVE_POWER   7 /* sum of all phases */
+#define METERSIM_HISTORY_REACTIVE_POWER 8 /* sum of all phases */
+#define METERSIM_HISTORY_TARIFF         9
+#define METERSIM_HISTORY_FIELDS         10
+
+
+typedef struct {
+	int32_t timestamp; /* (s) uptime at which the quantity changed */
+	double value;
+} metersim_historyPoint_t;
+
+
+/* Conditions of watchpoints, each triggers when it becomes true */
+#define METERSIM_WATCH_POWER_ABOVE   0 /* total active power rises above the threshold (W) */
+#define METERSIM_WATCH_POWER_BELOW   1 /* total active power falls below the threshold (W) */
+#define METERSIM_WATCH_TARIFF_CHANGE 2 /* current tariff changes, the threshold is ignored */
+#define METERSIM_WATCH_ENERGY_CROSS  3 /* grand total of activePlus reaches the threshold (Ws) */
+
+#define METERSIM_MAX_WATCHPOINTS 16
+
+
+/* Quantities observed by subscriptions */
+#define METERSIM_NOTIFY_TARIFF  (1u << 0) /* current tariff changes */
+#define METERSIM_NOTIFY_VOLTAGE (1u << 1) /* voltage of a phase leaves its deadband */
+#define METERSIM_NOTIFY_POWER   (1u << 2) /* total active power leaves its deadband */
+#define METERSIM_NOTIFY_ENERGY  (1u << 3) /* grand total of activePlus reaches the next boundary */
+
+#define METERSIM_MAX_SUBSCRIPTIONS 16
+
+
+/* Deadbands around the values at the last notification */
+typedef struct {
+	double voltage; /* relative, e.g. 0.01 for 1% of the voltage */
+	double power;   /* (W) */
+	double energy;  /* (Ws) distance of the boundaries, e.g. 3600000 for each kWh */
+} metersim_deadband_t;
+
+
+/* Groups of values captured by metersim_stepAndSample */
+#define METERSIM_SAMPLE_INSTANT (1u << 0)
+#define METERSIM_SAMPLE_POWER   (1u << 1)
+#define METERSIM_SAMPLE_ENERGY  (1u << 2)
+#define METERSIM_SAMPLE_ALL     (METERSIM_SAMPLE_INSTANT | METERSIM_SAMPLE_POWER | METERSIM_SAMPLE_ENERGY)
+
+
+typedef struct {
+	int32_t timestamp;          /* (s) uptime at which the sample was taken */
+	metersim_instant_t instant; /* METERSIM_SAMPLE_INSTANT */
+	metersim_power_t power;     /* METERSIM_SAMPLE_POWER */
+	metersim_energy_t energy;   /* METERSIM_SAMPLE_ENERGY, grand total (all phases, all tariffs) */
+} metersim_sample_t;
+
+
+/* Groups of values returned by metersim_getSnapshot */
+#define METERSIM_SNAPSHOT_INSTANT (1u << 0)
+#define METERSIM_SNAPSHOT_POWER   (1u << 1)
+#define METERSIM_SNAPSHOT_ENERGY  (1u << 2)
+#define METERSIM_SNAPSHOT_VECTOR  (1u << 3)
+#define METERSIM_SNAPSHOT_THD     (1u << 4)
+#define METERSIM_SNAPSHOT_ALL     (0x1fu)
+
+
+typedef struct {
+	int32_t timestamp;          /* (s) uptime of the readings */
+	int64_t timeUtc;            /* UTC timestamp of the readings */
+	uint8_t currentTariff;
+	metersim_instant_t instant; /* METERSIM_SNAPSHOT_INSTANT, with the frequency */
+	metersim_power_t power;     /* METERSIM_SNAPSHOT_POWER */
+	metersim_energy_t energy;   /* METERSIM_SNAPSHOT_ENERGY, grand total (all phases, all tariffs) */
+	metersim_vector_t vector;   /* METERSIM_SNAPSHOT_VECTOR */
+	metersim_thd_t thd;         /* METERSIM_SNAPSHOT_THD */
+} metersim_snapshot_t;
+
+
+/* Latencies measured by the runner */
+#define METERSIM_LATENCY_WAKEUP 0 /* lateness of the runner wakeups after their deadlines */
+#define METERSIM_LATENCY_STEP   1 /* from the deadline of an event until the simulator is stepped to it */
+#define METERSIM_LATENCY_KINDS  2
+
+#define METERSIM_LATENCY_BUCKETS 32
+
+
+typedef struct {
+	uint64_t count[METERSIM_LATENCY_BUCKETS]; /* bucket 0: below 1 us, bucket i: [2^(i-1), 2^i) us, the last one also above */
+	uint64_t samples;
+	int64_t max; /* (ns) */
+	int64_t sum; /* (ns) */
+} metersim_latency_t;
+
+
+/* Scheduling policies of the runner thread */
+#define METERSIM_SCHED_DEFAULT 0 /* inherited from the creating thread */
+#define METERSIM_SCHED_FIFO    1
+#define METERSIM_SCHED_RR      2
+
+
+typedef struct {
+	int cpu;        /* CPU the runner thread is bound to, -1 for any */
+	int policy;     /* METERSIM_SCHED_* */
+	int priority;   /* real-time priority for METERSIM_SCHED_FIFO and METERSIM_SCHED_RR */
+	int lockMemory; /* lock all pages of the process in memory before starting the thread, kept after the runner is destroyed */
+	struct metersim_clock_s *clock; /* manual clock driving the runner, NULL for the system monotonic clock */
+} metersim_runnerOpts_t;
+
+
 typedef struct {
 	double _Complex voltage[3];
 	int32_t now;
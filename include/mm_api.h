@@ -146,6 +146,74 @@ int mme_getEnergyTotal(mm_ctx_T *, struct mme_dataEnergy *ret);
 int mme_getEnergyTariff(mm_ctx_T *, struct mme_dataEnergy ret[3], int idxTariff);
 
 
+struct mme_dataDemand {
+	float last[2];      /* average active power over the last demand window (import, export) */
+	float max[2];       /* maximum demand (import, export) */
+	int64_t maxTime[2]; /* UTC timestamp of the end of the window with maximum demand */
+};
+
+/* Get demand registers particularly per tariff */
+int mme_getDemand(mm_ctx_T *, struct mme_dataDemand *ret, int idxTariff);
+
+
+struct mme_dataProfile {
+	int64_t timestamp;            /* UTC timestamp of the end of the capture period */
+	struct mme_dataEnergy energy; /* energy registers grand total at the end of the period */
+	float frequency;              /* averages over the period */
+	float u[3];
+	float i[3];
+};
+
+/* Get load profile entries captured within [fromUtc, toUtc]. Returns the number of entries stored in `buf`. */
+int mme_getLoadProfile(mm_ctx_T *, int64_t fromUtc, int64_t toUtc, struct mme_dataProfile *buf, size_t n);
+
+
+/* Aggregation windows of power quality statistics */
+#define MME_PQ_WINDOW_10MIN 0
+#define MME_PQ_WINDOW_2H    1
+
+struct mme_dataPqAggregate {
+	float min;
+	float max;
+	float mean;
+	float p95;
+};
+
+struct mme_dataPqStats {
+	int64_t start; /* UTC timestamp of the start of the window */
+	int64_t end;   /* UTC timestamp of the end of the window */
+	struct mme_dataPqAggregate u[3];
+	struct mme_dataPqAggregate frequency;
+	struct mme_dataPqAggregate thdU[3];
+	struct mme_dataPqAggregate thdI[3];
+};
+
+/* Get statistics of voltage, frequency and THD over the last completed window (MME_PQ_WINDOW_*) */
+int mme_getPqStats(mm_ctx_T *, struct mme_dataPqStats *ret, int window);
+
+
+/* Types of power quality events */
+#define MME_PQ_SAG          0
+#define MME_PQ_SWELL        1
+#define MME_PQ_INTERRUPTION 2
+#define MME_PQ_PHASE_LOSS   3
+#define MME_PQ_THD_U        4
+#define MME_PQ_THD_I        5
+
+#define MME_PQ_EVENT_ONGOING (-1)
+
+struct mme_dataPqEvent {
+	int type;      /* MME_PQ_* */
+	int phase;     /* index of the phase, -1 for all phases */
+	int64_t start; /* UTC timestamp of the start of the event */
+	int64_t end;   /* UTC timestamp of the end of the event or MME_PQ_EVENT_ONGOING */
+	float extreme; /* lowest or highest value during the event */
+};
+
+/* Read and remove power quality events from the event log. Returns the number of events stored in `buf`. */
+int mme_getPqEvents(mm_ctx_T *, struct mme_dataPqEvent *buf, size_t n);
+
+
 struct mme_dataPower {
 	float p[3];   /* true power */
 	float q[3];   /* reactive power */
@@ -174,4 +242,20 @@ int mme_getThdI(mm_ctx_T *, float retThdI[3]);
 int mme_getThdU(mm_ctx_T *, float retThdU[3]);
 
 
+struct mme_dataAll {
+	int64_t timestamp;            /* UTC timestamp of the readouts */
+	int tariff;                   /* index of the current tariff */
+	float frequency;
+	struct mme_dataInstant instant;
+	struct mme_dataPower power;
+	struct mme_dataVector vector;
+	struct mme_dataEnergy energy; /* energy registers grand total */
+	float thdU[3];
+	float thdI[3];
+};
+
+/* Get all the readouts above taken at the same moment */
+int mme_getAll(mm_ctx_T *, struct mme_dataAll *ret);
+
+
 #endif /* end of MM_API */
@@ -30,6 +30,7 @@ from ctypes import (
 )
 
 from phoenixsystems.sem.utils import (
+    DataDemand,
     DataEnergy,
     DataInstant,
     DataPower,
@@ -115,6 +116,21 @@ class c_metersim_power_t(Structure):
         )
 
 
+class c_metersim_demand_t(Structure):
+    _fields_ = [
+        ("last", c_double * 2),
+        ("max", c_double * 2),
+        ("maxTime", c_int32 * 2),
+    ]
+
+    def get_py_struct(self) -> DataDemand:
+        return DataDemand(
+            [float(x) for x in self.last],
+            [float(x) for x in self.max],
+            [int(x) for x in self.maxTime],
+        )
+
+
 class c_metersim_thd_t(Structure):
     _fields_ = [
         ("thdU", c_float * 3),
@@ -128,6 +144,22 @@ class c_metersim_thd_t(Structure):
         )
 
 
+# Groups of values captured by step_and_sample
+SAMPLE_INSTANT = 1 << 0
+SAMPLE_POWER = 1 << 1
+SAMPLE_ENERGY = 1 << 2
+SAMPLE_ALL = SAMPLE_INSTANT | SAMPLE_POWER | SAMPLE_ENERGY
+
+
+class c_metersim_sample_t(Structure):
+    _fields_ = [
+        ("timestamp", c_int32),
+        ("instant", c_metersim_instant_t),
+        ("power", c_metersim_power_t),
+        ("energy", c_metersim_energy_t),
+    ]
+
+
 LIB_DIR = Path(__file__).resolve().parent
 lib = CDLL(str(LIB_DIR / "libsemsim_py.so"))
 
@@ -164,6 +196,9 @@ lib.metersim_setSpeedup.restype = c_int
 lib.metersim_stepForward.argtypes = [c_void_p, c_int]
 lib.metersim_stepForward.restype = c_int
 
+lib.metersim_stepAndSample.argtypes = [c_void_p, c_uint, c_uint, c_uint, POINTER(c_metersim_sample_t), c_size_t]
+lib.metersim_stepAndSample.restype = c_int
+
 
 lib.metersim_getTariffCount.argtypes = [c_void_p, POINTER(c_int)]
 lib.metersim_getTariffCount.restype = None
@@ -201,6 +236,9 @@ lib.metersim_getEnergyTotal.restype = None
 lib.metersim_getEnergyTariff.argtypes = [c_void_p, POINTER(c_metersim_energy_t), c_int]
 lib.metersim_getEnergyTariff.restype = c_int
 
+lib.metersim_getDemand.argtypes = [c_void_p, POINTER(c_metersim_demand_t), c_int]
+lib.metersim_getDemand.restype = c_int
+
 lib.metersim_getPower.argtypes = [c_void_p, POINTER(c_metersim_power_t)]
 lib.metersim_getPower.restype = None
 
@@ -300,6 +338,17 @@ class Metersim:
         if status != 0:
             raise MetersimException("Step-forward not allowed. Runner still running.")
 
+    def step_and_sample(self, seconds: int, interval: int, fields: int = SAMPLE_ALL) -> Any:
+        # Returns the raw ctypes array, so that large runs need no per-sample conversion
+        n = seconds // interval if interval > 0 else 0
+        buf = (c_metersim_sample_t * n)()
+        status = lib.metersim_stepAndSample(self.ctx, c_uint(seconds), c_uint(interval), c_uint(fields), buf, c_size_t(n))
+        if status == -2:
+            raise MetersimException("Step-forward not allowed. Runner still running.")
+        if status < 0:
+            raise MetersimException("Invalid sampling parameters.")
+        return buf
+
     def get_tariff_count(self) -> int:
         ret = self._call_helper(lib.metersim_getTariffCount, c_int)
         return ret.contents.value
@@ -355,6 +404,13 @@ class Metersim:
         )
         return [ret[i].get_py_struct() for i in range(3)]
 
+    def get_demand(self, tariff: int) -> DataDemand:
+        ret = c_metersim_demand_t()
+        status = lib.metersim_getDemand(self.ctx, ret, tariff)
+        if status != 0:
+            raise MetersimException("Invalid tariff index")
+        return ret.get_py_struct()
+
     def get_power(self) -> DataPower:
         ret = self._call_helper(lib.metersim_getPower, c_metersim_power_t)
         return ret.contents.get_py_struct()
@@ -27,7 +27,7 @@ from ctypes import (
     byref,
 )
 
-from phoenixsystems.sem.utils import DataEnergy, DataInstant, DataPower, DataVector, c_dataVectorPy
+from phoenixsystems.sem.utils import DataDemand, DataEnergy, DataInstant, DataPower, DataVector, c_dataVectorPy
 
 
 """
@@ -82,6 +82,21 @@ class c_mme_dataEnergy(Structure):
         )
 
 
+class c_mme_dataDemand(Structure):
+    _fields_ = [
+        ("last", c_float * 2),
+        ("max", c_float * 2),
+        ("maxTime", c_int64 * 2),
+    ]
+
+    def get_py_struct(self):
+        return DataDemand(
+            [float(x) for x in self.last],
+            [float(x) for x in self.max],
+            [int(x) for x in self.maxTime],
+        )
+
+
 class c_mme_dataPower(Structure):
     _fields_ = [
         ("p", c_float * 3),
@@ -154,6 +169,9 @@ lib.mme_getEnergyTotal.restype = c_int
 lib.mme_getEnergyTariff.argtypes = [c_void_p, POINTER(c_mme_dataEnergy), c_int]
 lib.mme_getEnergyTariff.restype = c_int
 
+lib.mme_getDemand.argtypes = [c_void_p, POINTER(c_mme_dataDemand), c_int]
+lib.mme_getDemand.restype = c_int
+
 lib.mme_getPower.argtypes = [c_void_p, POINTER(c_mme_dataPower)]
 lib.mme_getPower.restype = c_int
 
@@ -305,6 +323,15 @@ class MMApiCtx:
         ret = [data[i].get_py_struct() for i in range(3)]
         return ret
 
+    def get_demand(self, tariff: int) -> DataDemand:
+        """Returns demand registers (import, export) of the tariff."""
+        data = self._call_helper(
+            lambda ctx, ret: lib.mme_getDemand(ctx, ret, tariff),
+            c_mme_dataDemand,
+        )
+        ret = data.contents.get_py_struct()
+        return ret
+
     def get_power(self) -> DataPower:
         """Returns power triangle (P, Q, S, phi angle)."""
         data = self._call_helper(lib.mme_getPower, c_mme_dataPower)
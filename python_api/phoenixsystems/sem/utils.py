@@ -46,6 +46,13 @@ class DataEnergy:
     """
 
 
+@dataclass
+class DataDemand:
+    last: list[float]  # [import, export]
+    max: list[float]
+    max_time: list[int]
+
+
 @dataclass
 class DataPower:
     p: list[float]
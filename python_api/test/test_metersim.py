@@ -145,6 +145,17 @@ def test_energy(sem):
         compare_energy(data_energy[i], expected[i])
         
         
+def test_step_and_sample(sem):
+    samples = sem.step_and_sample(20, 5)
+    assert len(samples) == 4
+    assert [s.timestamp for s in samples] == [5, 10, 15, 20]
+    assert sem.get_uptime() == 20
+
+    # The last sample should agree with the getters at the same moment
+    compare_energy(samples[3].energy.get_py_struct(), sem.get_energy_total())
+    compare_instant(samples[3].instant.get_py_struct(), sem.get_instant())
+
+
 def test_timeUtc(sem):
     epoch = 1751962320
     sem.set_time_utc(epoch)
@@ -28,7 +28,7 @@ then
 fi
 
 echo "Running test_metersim"
-"$BUILD_DIR"/test_metersim "$SCRIPT_DIR"/test/input/sc00 "$SCRIPT_DIR"/test/input/sc02 > "$BUILD_DIR"/results/test_metersim.txt 2>&1
+"$BUILD_DIR"/test_metersim "$SCRIPT_DIR"/test/input/sc00 "$SCRIPT_DIR"/test/input/sc02 "$SCRIPT_DIR"/test/input/sc03 > "$BUILD_DIR"/results/test_metersim.txt 2>&1
 status=$?
 if [[ $status != 0 ]]
 then
@@ -46,30 +46,18 @@ static void energyRegFromDouble(metersim_eregister_t *dst, double v)
 }
 
 
-void calculator_initScenario(metersim_state_t *state, metersim_scenario_t *scenario)
-{
-	state->energy = scenario->energy;
-
-	for (int tariff = 0; tariff < scenario->cfg.tariffCount; tariff++) {
-		for (int i = 0; i < scenario->cfg.phaseCount; i++) {
-			state->energy[tariff][i].apparentPlus.value = calculateApparent(state->energy[tariff][i].activePlus.value, state->energy[tariff][i].reactive[0].value + state->energy[tariff][i].reactive[3].value);
-			state->energy[tariff][i].apparentMinus.value = calculateApparent(state->energy[tariff][i].activeMinus.value, state->energy[tariff][i].reactive[1].value + state->energy[tariff][i].reactive[2].value);
-		}
-	}
-
-	state->cfg = scenario->cfg;
-}
-
-
-void calculator_prepareInfoForDevice(metersim_update_t *upd, metersim_infoForDevice_t *info)
-{
-	for (int i = 0; i < 3; i++) {
-		info->voltage[i] = upd->instant.voltage[i] * cexp(120.0 * i * M_PI / 180.0 * _Complex_I);
-	}
-}
+typedef struct calculator_kernels_s {
+	void (*handleUpdate)(metersim_state_t *state, metersim_update_t *upd, calculator_bias_t *bias);
+	void (*accumulateEnergy)(metersim_state_t *state, int32_t dt);
+	void (*getEnergyTotal)(const metersim_state_t *state, metersim_energy_t *ret);
+} calculator_kernels_t;
 
 
-void calculator_handleUpdate(metersim_state_t *state, metersim_update_t *upd, calculator_bias_t *bias)
+/*
+ * Kernels are inlined into variants with a constant number of phases,
+ * letting the compiler unroll the loops over phases.
+ */
+static inline __attribute__((always_inline)) void handleUpdateKernel(metersim_state_t *state, metersim_update_t *upd, calculator_bias_t *bias, const int phases)
 {
 	metersim_instant_t instant = { 0 };
 	metersim_power_t power = { 0 };
@@ -84,7 +72,7 @@ void calculator_handleUpdate(metersim_state_t *state, metersim_update_t *upd, ca
 
 	double i_angle;
 	vector.complexNeutral = 0;
-	for (int i = 0; i < state->cfg.phaseCount; i++) {
+	for (int i = 0; i < phases; i++) {
 		vector.phaseVoltage[i] = instant.voltage[i] * cexp(120.0 * i * M_PI / 180.0 * _Complex_I);
 
 		i_angle = 120.0 * i + instant.uiAngle[i];
@@ -94,7 +82,7 @@ void calculator_handleUpdate(metersim_state_t *state, metersim_update_t *upd, ca
 		vector.complexNeutral -= vector.phaseCurrent[i];
 	}
 
-	for (int i = 0; i < state->cfg.phaseCount; i++) {
+	for (int i = 0; i < phases; i++) {
 		instant.current[i] = cabs(vector.phaseCurrent[i]);
 
 		/* Get the ui angle as degrees in interval [0, 360) */
@@ -112,14 +100,14 @@ void calculator_handleUpdate(metersim_state_t *state, metersim_update_t *upd, ca
 	}
 	instant.currentNeutral = cabs(vector.complexNeutral);
 
-	for (int i = 0; i < state->cfg.phaseCount; i++) {
+	for (int i = 0; i < phases; i++) {
 		power.apparentPower[i] = instant.voltage[i] * instant.current[i];
 		power.truePower[i] = cos(instant.uiAngle[i] * M_PI / 180.0) * power.apparentPower[i];
 		power.reactivePower[i] = sin(instant.uiAngle[i] * M_PI / 180.0) * power.apparentPower[i];
 		power.phi[i] = instant.uiAngle[i];
 	}
 
-	for (int i = 0; i < state->cfg.phaseCount; i++) {
+	for (int i = 0; i < phases; i++) {
 		vector.complexPower[i] = power.apparentPower[i] * cexp(instant.uiAngle[i] * M_PI / 180.0 * _Complex_I);
 	}
 
@@ -133,8 +121,9 @@ void calculator_handleUpdate(metersim_state_t *state, metersim_update_t *upd, ca
 }
 
 
-void calculator_accumulateEnergy(metersim_state_t *state, int32_t dt)
+static inline __attribute__((always_inline)) void accumulateEnergyKernel(metersim_state_t *state, int32_t dt, const int phases)
 {
+	metersim_energy_t *energy = state->energy[state->currentTariff];
 	int quadrant;
 
 	bool isPositiveEreactive;
@@ -142,7 +131,7 @@ void calculator_accumulateEnergy(metersim_state_t *state, int32_t dt)
 	metersim_eregister_t ereactive;
 	metersim_eregister_t eactive;
 
-	for (int i = 0; i < state->cfg.phaseCount; i++) {
+	for (int i = 0; i < phases; i++) {
 		energyRegFromDouble(&eapparent, (double)dt * state->power.apparentPower[i]);
 		energyRegFromDouble(&ereactive, (double)dt * state->power.reactivePower[i]);
 		energyRegFromDouble(&eactive, (double)dt * state->power.truePower[i]);
@@ -151,17 +140,160 @@ void calculator_accumulateEnergy(metersim_state_t *state, int32_t dt)
 
 		if (eactive.value < 0) {
 			quadrant = isPositiveEreactive ? 2 : 3;
-			addEnergyRegisters(&state->energy[state->currentTariff][i].activeMinus, &eactive, -1);
-			addEnergyRegisters(&state->energy[state->currentTariff][i].apparentMinus, &eapparent, 1);
+			addEnergyRegisters(&energy[i].activeMinus, &eactive, -1);
+			addEnergyRegisters(&energy[i].apparentMinus, &eapparent, 1);
 		}
 		else {
 			quadrant = isPositiveEreactive ? 1 : 4;
-			addEnergyRegisters(&state->energy[state->currentTariff][i].activePlus, &eactive, 1);
-			addEnergyRegisters(&state->energy[state->currentTariff][i].apparentPlus, &eapparent, 1);
+			addEnergyRegisters(&energy[i].activePlus, &eactive, 1);
+			addEnergyRegisters(&energy[i].apparentPlus, &eapparent, 1);
+		}
+
+		addEnergyRegisters(&energy[i].reactive[quadrant - 1], &ereactive, isPositiveEreactive ? 1 : -1);
+	}
+}
+
+
+static inline __attribute__((always_inline)) void getEnergyTotalKernel(const metersim_state_t *state, metersim_energy_t *ret, const int phases)
+{
+	*ret = (metersim_energy_t) { 0 };
+
+	for (int tariff = 0; tariff < state->cfg.tariffCount; tariff++) {
+		for (int phase = 0; phase < phases; phase++) {
+			ret->activeMinus.value += state->energy[tariff][phase].activeMinus.value;
+			ret->activePlus.value += state->energy[tariff][phase].activePlus.value;
+			ret->apparentMinus.value += state->energy[tariff][phase].apparentMinus.value;
+			ret->apparentPlus.value += state->energy[tariff][phase].apparentPlus.value;
+			for (int i = 0; i < 4; i++) {
+				ret->reactive[i].value += state->energy[tariff][phase].reactive[i].value;
+			}
 		}
+	}
+}
+
+
+#define DEFINE_KERNELS(suffix, phases) \
+	static void handleUpdate##suffix(metersim_state_t *state, metersim_update_t *upd, calculator_bias_t *bias) \
+	{ \
+		handleUpdateKernel(state, upd, bias, (phases)); \
+	} \
+	static void accumulateEnergy##suffix(metersim_state_t *state, int32_t dt) \
+	{ \
+		accumulateEnergyKernel(state, dt, (phases)); \
+	} \
+	static void getEnergyTotal##suffix(const metersim_state_t *state, metersim_energy_t *ret) \
+	{ \
+		getEnergyTotalKernel(state, ret, (phases)); \
+	} \
+	static const calculator_kernels_t kernels##suffix = { \
+		.handleUpdate = handleUpdate##suffix, \
+		.accumulateEnergy = accumulateEnergy##suffix, \
+		.getEnergyTotal = getEnergyTotal##suffix, \
+	}
+
+DEFINE_KERNELS(1Phase, 1);
+DEFINE_KERNELS(3Phase, 3);
+DEFINE_KERNELS(Generic, state->cfg.phaseCount);
+
+
+void calculator_initScenario(metersim_state_t *state, metersim_scenario_t *scenario)
+{
+	state->energy = scenario->energy;
 
-		addEnergyRegisters(&state->energy[state->currentTariff][i].reactive[quadrant - 1], &ereactive, isPositiveEreactive ? 1 : -1);
+	for (int tariff = 0; tariff < scenario->cfg.tariffCount; tariff++) {
+		for (int i = 0; i < scenario->cfg.phaseCount; i++) {
+			state->energy[tariff][i].apparentPlus.value = calculateApparent(state->energy[tariff][i].activePlus.value, state->energy[tariff][i].reactive[0].value + state->energy[tariff][i].reactive[3].value);
+			state->energy[tariff][i].apparentMinus.value = calculateApparent(state->energy[tariff][i].activeMinus.value, state->energy[tariff][i].reactive[1].value + state->energy[tariff][i].reactive[2].value);
+		}
 	}
+
+	state->cfg = scenario->cfg;
+
+	switch (state->cfg.phaseCount) {
+		case 1:
+			state->kernels = &kernels1Phase;
+			break;
+		case 3:
+			state->kernels = &kernels3Phase;
+			break;
+		default:
+			state->kernels = &kernelsGeneric;
+			break;
+	}
+}
+
+
+void calculator_prepareInfoForDevice(metersim_update_t *upd, metersim_infoForDevice_t *info)
+{
+	for (int i = 0; i < 3; i++) {
+		info->voltage[i] = upd->instant.voltage[i] * cexp(120.0 * i * M_PI / 180.0 * _Complex_I);
+	}
+}
+
+
+void calculator_handleUpdate(metersim_state_t *state, metersim_update_t *upd, calculator_bias_t *bias)
+{
+	state->kernels->handleUpdate(state, upd, bias);
+}
+
+
+void calculator_handleScalarUpdate(metersim_state_t *state, metersim_update_t *upd)
+{
+	state->currentTariff = upd->currentTariff;
+	state->instant.frequency = upd->instant.frequency;
+	state->thd = upd->thd;
+}
+
+
+void calculator_accumulateEnergy(metersim_state_t *state, int32_t dt)
+{
+	state->kernels->accumulateEnergy(state, dt);
+}
+
+
+void calculator_getEnergyTotal(const metersim_state_t *state, metersim_energy_t *ret)
+{
+	state->kernels->getEnergyTotal(state, ret);
+}
+
+
+double calculator_getTotalPower(const metersim_state_t *state)
+{
+	double sum = 0;
+
+	for (int i = 0; i < state->cfg.phaseCount; i++) {
+		sum += state->power.truePower[i];
+	}
+
+	return sum;
+}
+
+
+double calculator_getImportPower(const metersim_state_t *state)
+{
+	double sum = 0;
+
+	for (int i = 0; i < state->cfg.phaseCount; i++) {
+		if (state->power.truePower[i] > 0) {
+			sum += state->power.truePower[i];
+		}
+	}
+
+	return sum;
+}
+
+
+int64_t calculator_getActivePlus(const metersim_state_t *state)
+{
+	int64_t sum = 0;
+
+	for (int tariff = 0; tariff < state->cfg.tariffCount; tariff++) {
+		for (int i = 0; i < state->cfg.phaseCount; i++) {
+			sum += state->energy[tariff][i].activePlus.value;
+		}
+	}
+
+	return sum;
 }
 
 
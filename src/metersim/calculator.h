@@ -18,6 +18,7 @@ typedef struct {
 } calculator_bias_t;
 
 
+/* Also selects the calculation kernels for the phase count of the scenario */
 void calculator_initScenario(metersim_state_t *state, metersim_scenario_t *scenario);
 
 
@@ -27,9 +28,29 @@ void calculator_prepareInfoForDevice(metersim_update_t *upd, metersim_infoForDev
 void calculator_handleUpdate(metersim_state_t *state, metersim_update_t *upd, calculator_bias_t *bias);
 
 
+/* Applies an update which does not change voltages or currents, the phasors are kept */
+void calculator_handleScalarUpdate(metersim_state_t *state, metersim_update_t *upd);
+
+
 void calculator_accumulateEnergy(metersim_state_t *state, int32_t dt);
 
 
+/* Sums the energy registers of all phases and tariffs */
+void calculator_getEnergyTotal(const metersim_state_t *state, metersim_energy_t *ret);
+
+
+/* Sums the active power of all phases */
+double calculator_getTotalPower(const metersim_state_t *state);
+
+
+/* Active power counted to activePlus registers, phases in export do not add up */
+double calculator_getImportPower(const metersim_state_t *state);
+
+
+/* Sums the activePlus registers of all phases and tariffs */
+int64_t calculator_getActivePlus(const metersim_state_t *state);
+
+
 void calculator_accumulateBias(calculator_bias_t *bias, metersim_deviceResponse_t *res);
 
 #endif /* CALCULATOR_H */
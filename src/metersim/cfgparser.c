@@ -44,6 +44,30 @@ static void handleEnergyRegister(toml_table_t *phase, const char *regName, meter
 }
 
 
+static void handleDouble(toml_table_t *table, const char *name, double maxVal, double *dst)
+{
+	double value;
+	toml_datum_t val = toml_double_in(table, name);
+	if (val.ok) {
+		value = val.u.d;
+	}
+	else {
+		val = toml_int_in(table, name);
+		if (!val.ok) {
+			return;
+		}
+		value = (double)val.u.i;
+	}
+
+	if (value >= 0 && value <= maxVal) {
+		*dst = value;
+	}
+	else {
+		log_error("Parsed invalid value: %s", name);
+	}
+}
+
+
 int cfgparser_readScenario(metersim_scenario_t *scenario, const char *filename)
 {
 	FILE *fd;
@@ -120,6 +144,116 @@ int cfgparser_readScenario(metersim_scenario_t *scenario, const char *filename)
 		}
 	}
 
+	val = toml_int_in(conf, "demandPeriod");
+	if (val.ok) {
+		valInt = val.u.i;
+		if (valInt >= 0 && valInt <= METERSIM_MAX_DEMAND_PERIOD) {
+			scenario->cfg.demandPeriod = valInt;
+		}
+		else {
+			log_error("Parsed invalid demand period");
+		}
+	}
+
+	val = toml_int_in(conf, "demandSubperiods");
+	if (val.ok) {
+		valInt = val.u.i;
+		if (valInt > 0 && valInt <= METERSIM_MAX_SUBPERIODS) {
+			scenario->cfg.demandSubperiods = valInt;
+		}
+		else {
+			log_error("Parsed invalid number of demand subperiods");
+		}
+	}
+
+	if (scenario->cfg.demandSubperiods != 0 && scenario->cfg.demandPeriod % scenario->cfg.demandSubperiods != 0) {
+		log_error("Demand period is not a multiple of the number of subperiods. Disabling demand registers.");
+		scenario->cfg.demandPeriod = 0;
+	}
+
+	val = toml_int_in(conf, "loadProfilePeriod");
+	if (val.ok) {
+		valInt = val.u.i;
+		if (valInt >= 0 && valInt <= METERSIM_MAX_PROFILE_PERIOD) {
+			scenario->cfg.loadProfilePeriod = valInt;
+		}
+		else {
+			log_error("Parsed invalid load profile period");
+		}
+	}
+
+	val = toml_int_in(conf, "loadProfileCapacity");
+	if (val.ok) {
+		valInt = val.u.i;
+		if (valInt > 0 && valInt <= METERSIM_MAX_PROFILE_ENTRIES) {
+			scenario->cfg.loadProfileCapacity = valInt;
+		}
+		else {
+			log_error("Parsed invalid load profile capacity");
+		}
+	}
+
+	val = toml_int_in(conf, "waveformSampleRate");
+	if (val.ok) {
+		valInt = val.u.i;
+		if (valInt >= 0 && valInt <= METERSIM_MAX_SAMPLE_RATE) {
+			scenario->cfg.waveformSampleRate = valInt;
+		}
+		else {
+			log_error("Parsed invalid waveform sample rate");
+		}
+	}
+
+	val = toml_int_in(conf, "pulseBufferSize");
+	if (val.ok) {
+		valInt = val.u.i;
+		if (valInt >= 0 && valInt <= METERSIM_MAX_PULSE_BUFFER && (valInt & (valInt - 1)) == 0) {
+			scenario->cfg.pulseBufferSize = valInt;
+		}
+		else {
+			log_error("Parsed invalid pulse buffer size, it must be a power of 2");
+		}
+	}
+
+	val = toml_int_in(conf, "historyRetention");
+	if (val.ok) {
+		valInt = val.u.i;
+		if (valInt >= 0 && valInt <= METERSIM_MAX_HISTORY_RETENTION) {
+			scenario->cfg.historyRetention = valInt;
+		}
+		else {
+			log_error("Parsed invalid history retention");
+		}
+	}
+
+	toml_table_t *pq = toml_table_in(conf, "powerQuality");
+	if (pq != NULL) {
+		/* THD-U is checked by default only in scenarios configuring power quality */
+		scenario->cfg.pq.thdUThreshold = 0.08;
+		handleDouble(pq, "nominalVoltage", METERSIM_MAX_VOLTAGE, &scenario->cfg.pq.nominalVoltage);
+		handleDouble(pq, "sagThreshold", 1, &scenario->cfg.pq.sagThreshold);
+		handleDouble(pq, "swellThreshold", METERSIM_MAX_VOLTAGE, &scenario->cfg.pq.swellThreshold);
+		handleDouble(pq, "interruptionThreshold", 1, &scenario->cfg.pq.interruptionThreshold);
+		handleDouble(pq, "thdUThreshold", METERSIM_MAX_THDU, &scenario->cfg.pq.thdUThreshold);
+		handleDouble(pq, "thdIThreshold", METERSIM_MAX_THDI, &scenario->cfg.pq.thdIThreshold);
+	}
+
+#ifdef METERSIM_ERROR_MODEL
+	toml_table_t *error = toml_table_in(conf, "errorModel");
+	if (error != NULL) {
+		val = toml_int_in(error, "seed");
+		if (val.ok) {
+			scenario->cfg.error.seed = (uint64_t)val.u.i;
+		}
+		handleDouble(error, "voltageGain", 1, &scenario->cfg.error.voltageGain);
+		handleDouble(error, "currentGain", 1, &scenario->cfg.error.currentGain);
+		handleDouble(error, "phaseError", 180, &scenario->cfg.error.phaseError);
+		handleDouble(error, "noise", 1, &scenario->cfg.error.noise);
+		handleDouble(error, "voltageResolution", METERSIM_MAX_VOLTAGE, &scenario->cfg.error.voltageResolution);
+		handleDouble(error, "currentResolution", METERSIM_MAX_CURRENT, &scenario->cfg.error.currentResolution);
+	}
+#endif
+
 	val = toml_timestamp_in(conf, "startTimestamp");
 	if (val.ok) {
 		struct tm s;
@@ -0,0 +1,142 @@
+/*
+ * Clock sources of the SEM simulator runners
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "clocksrc.h"
+
+#define NSEC_PER_SEC (1000 * 1000 * 1000)
+
+
+static bool hasPassed(clocksrc_t *src, const struct timespec *ts)
+{
+	struct timespec now;
+	clocksrc_gettime(src, &now);
+	return now.tv_sec > ts->tv_sec || (now.tv_sec == ts->tv_sec && now.tv_nsec >= ts->tv_nsec);
+}
+
+
+void clocksrc_gettime(clocksrc_t *src, struct timespec *ret)
+{
+	int64_t now;
+
+	if (src == NULL) {
+		clock_gettime(CLOCK_MONOTONIC, ret);
+		return;
+	}
+
+	now = __atomic_load_n(&src->now, __ATOMIC_ACQUIRE);
+	ret->tv_sec = now / NSEC_PER_SEC;
+	ret->tv_nsec = now % NSEC_PER_SEC;
+}
+
+
+int clocksrc_timedwait(clocksrc_t *src, pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *ts)
+{
+	if (src == NULL) {
+		return pthread_cond_timedwait(cond, lock, ts);
+	}
+
+	/* The time cannot move between the check and the wait, clocksrc_advance needs `lock` to wake us up */
+	if (hasPassed(src, ts)) {
+		return ETIMEDOUT;
+	}
+	pthread_cond_wait(cond, lock);
+
+	return hasPassed(src, ts) ? ETIMEDOUT : 0;
+}
+
+
+int clocksrc_register(clocksrc_t *src, pthread_mutex_t *lock, pthread_cond_t *cond)
+{
+	clocksrc_waiter_t *waiters;
+	size_t capacity;
+
+	if (src == NULL) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&src->lock);
+	if (src->waiterCount == src->waiterCapacity) {
+		capacity = src->waiterCapacity == 0 ? 4 : 2 * src->waiterCapacity;
+		waiters = realloc(src->waiters, capacity * sizeof(clocksrc_waiter_t));
+		if (waiters == NULL) {
+			pthread_mutex_unlock(&src->lock);
+			return -1;
+		}
+		src->waiters = waiters;
+		src->waiterCapacity = capacity;
+	}
+
+	src->waiters[src->waiterCount].lock = lock;
+	src->waiters[src->waiterCount].cond = cond;
+	src->waiterCount++;
+	pthread_mutex_unlock(&src->lock);
+
+	return 0;
+}
+
+
+void clocksrc_unregister(clocksrc_t *src, pthread_cond_t *cond)
+{
+	if (src == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&src->lock);
+	for (size_t i = 0; i < src->waiterCount; i++) {
+		if (src->waiters[i].cond == cond) {
+			src->waiters[i] = src->waiters[--src->waiterCount];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&src->lock);
+}
+
+
+void clocksrc_advance(clocksrc_t *src, int64_t nsec)
+{
+	pthread_mutex_lock(&src->lock);
+	__atomic_fetch_add(&src->now, nsec, __ATOMIC_RELEASE);
+
+	for (size_t i = 0; i < src->waiterCount; i++) {
+		pthread_mutex_lock(src->waiters[i].lock);
+		pthread_cond_broadcast(src->waiters[i].cond);
+		pthread_mutex_unlock(src->waiters[i].lock);
+	}
+	pthread_mutex_unlock(&src->lock);
+}
+
+
+clocksrc_t *clocksrc_initManual(void)
+{
+	clocksrc_t *src = calloc(1, sizeof(clocksrc_t));
+	if (src == NULL) {
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&src->lock, NULL) != 0) {
+		free(src);
+		return NULL;
+	}
+
+	return src;
+}
+
+
+void clocksrc_destroy(clocksrc_t *src)
+{
+	pthread_mutex_destroy(&src->lock);
+	free(src->waiters);
+	free(src);
+}
@@ -0,0 +1,66 @@
+/*
+ * Clock sources of the SEM simulator runners
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef CLOCKSRC_H
+#define CLOCKSRC_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <metersim/metersim.h>
+
+
+typedef struct {
+	pthread_mutex_t *lock;
+	pthread_cond_t *cond;
+} clocksrc_waiter_t;
+
+
+/* Manual clock, its time moves only with clocksrc_advance. A NULL source stands for CLOCK_MONOTONIC. */
+struct metersim_clock_s {
+	int64_t now; /* (ns) accessed atomically */
+
+	clocksrc_waiter_t *waiters; /* conditions woken up when the time moves */
+	size_t waiterCount;
+	size_t waiterCapacity;
+
+	pthread_mutex_t lock;
+};
+
+typedef struct metersim_clock_s clocksrc_t;
+
+
+void clocksrc_gettime(clocksrc_t *src, struct timespec *ret);
+
+
+/*
+ * Waits on `cond` until the absolute time `ts` of the source or a signal. Returns ETIMEDOUT if `ts` has passed.
+ * For a manual source `cond` has to be registered with clocksrc_register.
+ */
+int clocksrc_timedwait(clocksrc_t *src, pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *ts);
+
+
+/* Registers `cond` to be broadcast, with `lock` held, whenever the time moves. Must be called without `lock` held. */
+int clocksrc_register(clocksrc_t *src, pthread_mutex_t *lock, pthread_cond_t *cond);
+
+
+void clocksrc_unregister(clocksrc_t *src, pthread_cond_t *cond);
+
+
+void clocksrc_advance(clocksrc_t *src, int64_t nsec);
+
+
+clocksrc_t *clocksrc_initManual(void);
+
+
+void clocksrc_destroy(clocksrc_t *src);
+
+#endif /* CLOCKSRC_H */
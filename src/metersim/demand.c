@@ -0,0 +1,111 @@
+/*
+ * Maximum demand registers of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "demand.h"
+
+
+void demand_init(demand_ctx_t *ctx, const metersim_config_t *cfg)
+{
+	memset(ctx, 0, sizeof(*ctx));
+
+	if (cfg->demandPeriod == 0 || cfg->demandSubperiods == 0) {
+		ctx->nextBoundary = METERSIM_NO_UPDATE_SCHEDULED;
+		return;
+	}
+
+	ctx->subperiodCount = cfg->demandSubperiods;
+	ctx->subperiod = cfg->demandPeriod / cfg->demandSubperiods;
+	ctx->nextBoundary = ctx->subperiod;
+}
+
+
+void demand_accumulate(demand_ctx_t *ctx, const metersim_state_t *state, int32_t dt)
+{
+	double p;
+
+	if (ctx->subperiod == 0) {
+		return;
+	}
+
+	for (int i = 0; i < state->cfg.phaseCount; i++) {
+		p = state->power.truePower[i] * (double)dt;
+		if (p < 0) {
+			ctx->energy[1] -= p;
+		}
+		else {
+			ctx->energy[0] += p;
+		}
+	}
+}
+
+
+int32_t demand_getNextBoundary(demand_ctx_t *ctx)
+{
+	return ctx->nextBoundary;
+}
+
+
+void demand_closeSubperiod(demand_ctx_t *ctx, uint8_t tariff, int32_t now)
+{
+	const double period = (double)ctx->subperiod * ctx->subperiodCount;
+
+	assert(now == ctx->nextBoundary);
+
+	/* Replace the oldest subperiod of the window with the one just completed */
+	for (int i = 0; i < 2; i++) {
+		ctx->windowSum[i] += ctx->energy[i] - ctx->window[ctx->head][i];
+		ctx->window[ctx->head][i] = ctx->energy[i];
+		ctx->energy[i] = 0;
+	}
+	ctx->head = (ctx->head + 1) % ctx->subperiodCount;
+
+	/* Once per window recompute the sum to get rid of accumulated rounding errors */
+	if (ctx->head == 0) {
+		for (int i = 0; i < 2; i++) {
+			ctx->windowSum[i] = 0;
+			for (int j = 0; j < ctx->subperiodCount; j++) {
+				ctx->windowSum[i] += ctx->window[j][i];
+			}
+		}
+	}
+	ctx->nextBoundary += ctx->subperiod;
+
+	if (ctx->filled < ctx->subperiodCount) {
+		ctx->filled++;
+	}
+
+	/* Demand is available only when the whole window has elapsed */
+	if (ctx->filled < ctx->subperiodCount) {
+		return;
+	}
+
+	for (int i = 0; i < 2; i++) {
+		ctx->last[i] = ctx->windowSum[i] / period;
+		if (ctx->last[i] > ctx->max[tariff][i]) {
+			ctx->max[tariff][i] = ctx->last[i];
+			ctx->maxTime[tariff][i] = now;
+		}
+	}
+}
+
+
+void demand_get(demand_ctx_t *ctx, metersim_demand_t *ret, int idxTariff)
+{
+	for (int i = 0; i < 2; i++) {
+		ret->last[i] = ctx->last[i];
+		ret->max[i] = ctx->max[idxTariff][i];
+		ret->maxTime[i] = ctx->maxTime[idxTariff][i];
+	}
+}
@@ -0,0 +1,57 @@
+/*
+ * Maximum demand registers of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef DEMAND_H
+#define DEMAND_H
+
+#include <stdint.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+
+#define DEMAND_MAX_SUBPERIODS METERSIM_MAX_SUBPERIODS
+
+
+typedef struct {
+	int32_t subperiod; /* (s) length of a subperiod, 0 if demand registers are disabled */
+	uint8_t subperiodCount;
+	int32_t nextBoundary;
+
+	double energy[2]; /* (Ws) active import/export accumulated in the current subperiod */
+
+	/* Ring of energies of the last completed subperiods and their running sum */
+	double window[DEMAND_MAX_SUBPERIODS][2];
+	double windowSum[2];
+	uint8_t head;
+	uint8_t filled;
+
+	double last[2];
+	double max[METERSIM_MAX_TARIFF_COUNT][2];
+	int32_t maxTime[METERSIM_MAX_TARIFF_COUNT][2];
+} demand_ctx_t;
+
+
+void demand_init(demand_ctx_t *ctx, const metersim_config_t *cfg);
+
+
+/* Accumulates energy of a segment with constant power. The segment must not cross the subperiod boundary. */
+void demand_accumulate(demand_ctx_t *ctx, const metersim_state_t *state, int32_t dt);
+
+
+/* Returns uptime at which the current subperiod ends */
+int32_t demand_getNextBoundary(demand_ctx_t *ctx);
+
+
+/* Closes the current subperiod and updates demand registers of the given tariff */
+void demand_closeSubperiod(demand_ctx_t *ctx, uint8_t tariff, int32_t now);
+
+
+void demand_get(demand_ctx_t *ctx, metersim_demand_t *ret, int idxTariff);
+
+#endif /* DEMAND_H */
@@ -147,6 +147,51 @@ devicemgr_ctx_t *devicemgr_init(void)
 }
 
 
+void devicemgr_reset(devicemgr_ctx_t *ctx)
+{
+	pthread_mutex_lock(&ctx->lock);
+	for (int i = 0; i < DEVICEMGR_MAX_DEVICES_COUNT; i++) {
+		free(ctx->devices[i]);
+		ctx->devices[i] = NULL;
+	}
+	ctx->deviceNum = 0;
+	ctx->nextUpdateTime = METERSIM_NO_UPDATE_SCHEDULED;
+	pthread_mutex_unlock(&ctx->lock);
+}
+
+
+devicemgr_ctx_t *devicemgr_clone(devicemgr_ctx_t *src)
+{
+	devicemgr_ctx_t *ctx = devicemgr_init();
+	if (ctx == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&src->lock);
+	for (int i = 0; i < DEVICEMGR_MAX_DEVICES_COUNT; i++) {
+		if (src->devices[i] == NULL) {
+			continue;
+		}
+
+		ctx->devices[i] = malloc(sizeof(metersim_deviceCtx_t));
+		if (ctx->devices[i] == NULL) {
+			pthread_mutex_unlock(&src->lock);
+			log_error("Could not clone device");
+			devicemgr_destroy(ctx);
+			return NULL;
+		}
+
+		/* Callback contexts are shared with the source */
+		*ctx->devices[i] = *src->devices[i];
+		ctx->deviceNum++;
+	}
+	ctx->nextUpdateTime = src->nextUpdateTime;
+	pthread_mutex_unlock(&src->lock);
+
+	return ctx;
+}
+
+
 void devicemgr_destroy(devicemgr_ctx_t *ctx)
 {
 	for (int i = 0; i < DEVICEMGR_MAX_DEVICES_COUNT; i++) {
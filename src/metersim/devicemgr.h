@@ -53,6 +53,14 @@ void devicemgr_updateDevices(devicemgr_ctx_t *ctx, calculator_bias_t *bias, mete
 devicemgr_ctx_t *devicemgr_init(void);
 
 
+/* Removes all devices */
+void devicemgr_reset(devicemgr_ctx_t *ctx);
+
+
+/* Copies the device list, callback contexts are not duplicated */
+devicemgr_ctx_t *devicemgr_clone(devicemgr_ctx_t *src);
+
+
 void devicemgr_destroy(devicemgr_ctx_t *ctx);
 
 #endif /* DEVICEMGR_H */
@@ -0,0 +1,185 @@
+/*
+ * Measurement error model of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifdef METERSIM_ERROR_MODEL
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "errormodel.h"
+
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+
+static uint64_t splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+
+static uint64_t next(errormodel_ctx_t *ctx)
+{
+	uint64_t *s = ctx->rng;
+	const uint64_t result = rotl(s[1] * 5, 7) * 9;
+	const uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+
+	return result;
+}
+
+
+/* Uniform in (0, 1] */
+static inline double uniform(errormodel_ctx_t *ctx)
+{
+	return ((next(ctx) >> 11) + 1) * 0x1.0p-53;
+}
+
+
+/* Draws 4 standard normal values at once (Box-Muller), one per phase and a spare */
+static void gaussian4(errormodel_ctx_t *ctx, double out[4])
+{
+	double u[4], r[2], theta[2];
+
+	for (int i = 0; i < 4; i++) {
+		u[i] = uniform(ctx);
+	}
+	for (int i = 0; i < 2; i++) {
+		r[i] = sqrt(-2 * log(u[2 * i]));
+		theta[i] = 2 * M_PI * u[2 * i + 1];
+	}
+	for (int i = 0; i < 2; i++) {
+		out[2 * i] = r[i] * cos(theta[i]);
+		out[2 * i + 1] = r[i] * sin(theta[i]);
+	}
+}
+
+
+static inline double quantize(double value, double step)
+{
+	return step > 0 ? round(value / step) * step : value;
+}
+
+
+void errormodel_init(errormodel_ctx_t *ctx, const metersim_config_t *cfg)
+{
+	uint64_t seed = cfg->error.seed;
+
+	memset(ctx, 0, sizeof(*ctx));
+
+	ctx->cfg = cfg->error;
+	ctx->enabled = cfg->error.voltageGain != 0 || cfg->error.currentGain != 0 || cfg->error.phaseError != 0 ||
+		cfg->error.noise != 0 || cfg->error.voltageResolution != 0 || cfg->error.currentResolution != 0;
+
+	for (int i = 0; i < 4; i++) {
+		ctx->rng[i] = splitmix64(&seed);
+	}
+
+	/* Errors of the channels are uniform within the limits of the accuracy class */
+	for (int i = 0; i < 3; i++) {
+		ctx->voltageGain[i] = 1 + ctx->cfg.voltageGain * (2 * uniform(ctx) - 1);
+		ctx->currentGain[i] = 1 + ctx->cfg.currentGain * (2 * uniform(ctx) - 1);
+		ctx->phaseError[i] = ctx->cfg.phaseError * (2 * uniform(ctx) - 1);
+	}
+}
+
+
+void errormodel_applyUpdate(errormodel_ctx_t *ctx, metersim_state_t *state)
+{
+	metersim_instant_t *instant = &state->instant;
+	metersim_power_t *power = &state->power;
+	metersim_vector_t *vector = &state->vector;
+	double angle;
+
+	if (!ctx->enabled) {
+		return;
+	}
+
+	vector->complexNeutral = 0;
+	for (int i = 0; i < state->cfg.phaseCount; i++) {
+		instant->voltage[i] *= ctx->voltageGain[i];
+		instant->current[i] *= ctx->currentGain[i];
+		instant->uiAngle[i] += ctx->phaseError[i];
+		if (instant->uiAngle[i] < 0) {
+			instant->uiAngle[i] += 360.0;
+		}
+		else if (instant->uiAngle[i] >= 360.0) {
+			instant->uiAngle[i] -= 360.0;
+		}
+		angle = instant->uiAngle[i] * M_PI / 180.0;
+
+		power->apparentPower[i] = instant->voltage[i] * instant->current[i];
+		power->truePower[i] = cos(angle) * power->apparentPower[i];
+		power->reactivePower[i] = sin(angle) * power->apparentPower[i];
+		power->phi[i] = instant->uiAngle[i];
+
+		/* Phasors as in calculator, with the measured magnitudes and angles */
+		vector->phaseVoltage[i] = instant->voltage[i] * cexp(120.0 * i * M_PI / 180.0 * _Complex_I);
+		vector->phaseCurrent[i] = instant->current[i] * cexp((120.0 * i * M_PI / 180.0 + angle) * _Complex_I);
+		vector->complexNeutral -= vector->phaseCurrent[i];
+		vector->complexPower[i] = power->apparentPower[i] * cexp(angle * _Complex_I);
+	}
+	instant->currentNeutral = cabs(vector->complexNeutral);
+}
+
+
+void errormodel_perturbInstant(errormodel_ctx_t *ctx, metersim_instant_t *instant)
+{
+	double nu[4], ni[4];
+
+	if (!ctx->enabled) {
+		return;
+	}
+
+	gaussian4(ctx, nu);
+	gaussian4(ctx, ni);
+
+	for (int i = 0; i < 3; i++) {
+		instant->voltage[i] = quantize(instant->voltage[i] * (1 + ctx->cfg.noise * nu[i]), ctx->cfg.voltageResolution);
+		instant->current[i] = quantize(instant->current[i] * (1 + ctx->cfg.noise * ni[i]), ctx->cfg.currentResolution);
+	}
+}
+
+
+void errormodel_perturbPower(errormodel_ctx_t *ctx, metersim_power_t *power)
+{
+	double n[4], k;
+
+	if (!ctx->enabled || ctx->cfg.noise == 0) {
+		return;
+	}
+
+	gaussian4(ctx, n);
+
+	/* The same factor keeps the power triangle consistent */
+	for (int i = 0; i < 3; i++) {
+		k = 1 + ctx->cfg.noise * n[i];
+		power->truePower[i] *= k;
+		power->reactivePower[i] *= k;
+		power->apparentPower[i] *= k;
+	}
+}
+
+#endif /* METERSIM_ERROR_MODEL */
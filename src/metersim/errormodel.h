@@ -0,0 +1,50 @@
+/*
+ * Measurement error model of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef ERRORMODEL_H
+#define ERRORMODEL_H
+
+#ifdef METERSIM_ERROR_MODEL
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+
+
+typedef struct {
+	bool enabled;
+	metersim_errorConfig_t cfg;
+
+	uint64_t rng[4]; /* xoshiro256** state */
+
+	/* Errors of the channels, drawn once per instance */
+	double voltageGain[3];
+	double currentGain[3];
+	double phaseError[3]; /* (degrees) */
+} errormodel_ctx_t;
+
+
+void errormodel_init(errormodel_ctx_t *ctx, const metersim_config_t *cfg);
+
+
+/* Applies gain and phase errors to the state after an update, so that they affect the energy accumulation */
+void errormodel_applyUpdate(errormodel_ctx_t *ctx, metersim_state_t *state);
+
+
+/* Applies noise and quantization to the values returned to the user */
+void errormodel_perturbInstant(errormodel_ctx_t *ctx, metersim_instant_t *instant);
+
+
+void errormodel_perturbPower(errormodel_ctx_t *ctx, metersim_power_t *power);
+
+#endif /* METERSIM_ERROR_MODEL */
+
+#endif /* ERRORMODEL_H */
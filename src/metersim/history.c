@@ -0,0 +1,477 @@
+/*
+ * Compressed history of the SEM simulator state
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "history.h"
+#include "log.h"
+
+#define LOG_TAG "history : "
+
+#define HISTORY_BLOCK_BITS (HISTORY_BLOCK_WORDS * 64)
+
+/* Upper bound of the size of a compressed point: timestamp 4 + 32 bits, value 2 + 5 + 6 + 64 bits */
+#define HISTORY_MAX_POINT_BITS 113
+
+/* Size of the uncompressed first point of a block */
+#define HISTORY_FIRST_POINT_BITS 96
+
+
+typedef struct {
+	const history_block_t *block;
+	uint32_t pos;
+	uint32_t index;
+
+	int32_t time;
+	int32_t delta;
+	uint64_t value;
+	uint8_t leading;
+	uint8_t trailing;
+} history_reader_t;
+
+
+static uint64_t doubleToBits(double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+
+static double bitsToDouble(uint64_t bits)
+{
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+static void writeBits(history_block_t *block, uint64_t value, unsigned int count)
+{
+	unsigned int word, offset, chunk;
+
+	while (count > 0) {
+		word = block->bits / 64;
+		offset = block->bits % 64;
+		chunk = 64 - offset < count ? 64 - offset : count;
+
+		/* Bits are written from the most significant one */
+		uint64_t part = (value >> (count - chunk)) & (chunk == 64 ? UINT64_MAX : ((1ull << chunk) - 1));
+		block->words[word] |= part << (64 - offset - chunk);
+
+		block->bits += chunk;
+		count -= chunk;
+	}
+}
+
+
+static uint64_t readBits(history_reader_t *r, unsigned int count)
+{
+	uint64_t ret = 0;
+	unsigned int word, offset, chunk;
+
+	while (count > 0) {
+		word = r->pos / 64;
+		offset = r->pos % 64;
+		chunk = 64 - offset < count ? 64 - offset : count;
+
+		uint64_t part = (r->block->words[word] >> (64 - offset - chunk)) & (chunk == 64 ? UINT64_MAX : ((1ull << chunk) - 1));
+		ret = chunk == 64 ? part : (ret << chunk) | part;
+
+		r->pos += chunk;
+		count -= chunk;
+	}
+
+	return ret;
+}
+
+
+static int64_t signExtend(uint64_t value, unsigned int bits)
+{
+	const uint64_t sign = 1ull << (bits - 1);
+	return (int64_t)((value ^ sign) - sign);
+}
+
+
+static void encodePoint(history_block_t *block, int32_t time, double value)
+{
+	uint64_t bits = doubleToBits(value);
+	uint64_t xor;
+	int32_t delta, dod;
+	uint8_t leading, trailing;
+
+	if (block->count == 0) {
+		writeBits(block, (uint32_t)time, 32);
+		writeBits(block, bits, 64);
+		block->first = time;
+		block->lastDelta = 0;
+		block->leading = 0xff;
+	}
+	else {
+		delta = time - block->last;
+		dod = delta - block->lastDelta;
+
+		if (dod == 0) {
+			writeBits(block, 0x0, 1);
+		}
+		else if (dod >= -64 && dod <= 63) {
+			writeBits(block, 0x2, 2);
+			writeBits(block, (uint32_t)dod, 7);
+		}
+		else if (dod >= -256 && dod <= 255) {
+			writeBits(block, 0x6, 3);
+			writeBits(block, (uint32_t)dod, 9);
+		}
+		else if (dod >= -2048 && dod <= 2047) {
+			writeBits(block, 0xe, 4);
+			writeBits(block, (uint32_t)dod, 12);
+		}
+		else {
+			writeBits(block, 0xf, 4);
+			writeBits(block, (uint32_t)dod, 32);
+		}
+		block->lastDelta = delta;
+
+		xor = bits ^ block->lastValue;
+		if (xor == 0) {
+			writeBits(block, 0x0, 1);
+		}
+		else {
+			leading = (uint8_t)__builtin_clzll(xor);
+			trailing = (uint8_t)__builtin_ctzll(xor);
+			if (leading > 31) {
+				leading = 31;
+			}
+
+			if (block->leading != 0xff && leading >= block->leading && trailing >= block->trailing) {
+				/* Meaningful bits fit into the window of the previous value */
+				writeBits(block, 0x2, 2);
+				writeBits(block, xor >> block->trailing, 64 - block->leading - block->trailing);
+			}
+			else {
+				writeBits(block, 0x3, 2);
+				writeBits(block, leading, 5);
+				writeBits(block, 63 - leading - trailing, 6);
+				writeBits(block, xor >> trailing, 64 - leading - trailing);
+				block->leading = leading;
+				block->trailing = trailing;
+			}
+		}
+	}
+
+	block->lastValue = bits;
+	block->last = time;
+	block->count++;
+}
+
+
+static void decodePoint(history_reader_t *r)
+{
+	uint64_t xor;
+	int32_t dod;
+	unsigned int length;
+
+	if (r->index == 0) {
+		r->time = (int32_t)readBits(r, 32);
+		r->value = readBits(r, 64);
+		r->delta = 0;
+		r->index++;
+		return;
+	}
+
+	if (readBits(r, 1) == 0) {
+		dod = 0;
+	}
+	else if (readBits(r, 1) == 0) {
+		dod = (int32_t)signExtend(readBits(r, 7), 7);
+	}
+	else if (readBits(r, 1) == 0) {
+		dod = (int32_t)signExtend(readBits(r, 9), 9);
+	}
+	else if (readBits(r, 1) == 0) {
+		dod = (int32_t)signExtend(readBits(r, 12), 12);
+	}
+	else {
+		dod = (int32_t)signExtend(readBits(r, 32), 32);
+	}
+	r->delta += dod;
+	r->time += r->delta;
+
+	if (readBits(r, 1) != 0) {
+		if (readBits(r, 1) != 0) {
+			r->leading = (uint8_t)readBits(r, 5);
+			length = (unsigned int)readBits(r, 6) + 1;
+			r->trailing = (uint8_t)(64 - r->leading - length);
+		}
+		xor = readBits(r, 64 - r->leading - r->trailing) << r->trailing;
+		r->value ^= xor;
+	}
+	r->index++;
+}
+
+
+static double getField(const metersim_state_t *state, int field)
+{
+	double sum = 0;
+
+	switch (field) {
+		case METERSIM_HISTORY_FREQUENCY:
+			return state->instant.frequency;
+
+		case METERSIM_HISTORY_ACTIVE_POWER:
+			for (int i = 0; i < state->cfg.phaseCount; i++) {
+				sum += state->power.truePower[i];
+			}
+			return sum;
+
+		case METERSIM_HISTORY_REACTIVE_POWER:
+			for (int i = 0; i < state->cfg.phaseCount; i++) {
+				sum += state->power.reactivePower[i];
+			}
+			return sum;
+
+		case METERSIM_HISTORY_TARIFF:
+			return state->currentTariff;
+
+		default:
+			break;
+	}
+
+	if (field >= METERSIM_HISTORY_CURRENT) {
+		return state->instant.current[field - METERSIM_HISTORY_CURRENT];
+	}
+	return state->instant.voltage[field - METERSIM_HISTORY_VOLTAGE];
+}
+
+
+static history_block_t *blockAt(const history_ctx_t *ctx, const history_series_t *series, uint32_t i)
+{
+	return series->blocks[(series->head + i) % ctx->capacity];
+}
+
+
+/* Returns a cleared block at the end of the ring, recycling the oldest one when the ring is full */
+static history_block_t *appendBlock(history_ctx_t *ctx, history_series_t *series)
+{
+	uint32_t idx;
+	history_block_t *block;
+
+	if (series->count == ctx->capacity) {
+		series->head = (series->head + 1) % ctx->capacity;
+		series->count--;
+	}
+
+	idx = (series->head + series->count) % ctx->capacity;
+	if (series->blocks[idx] == NULL) {
+		series->blocks[idx] = malloc(sizeof(history_block_t));
+		if (series->blocks[idx] == NULL) {
+			log_error("Could not allocate memory for history");
+			return NULL;
+		}
+	}
+
+	block = series->blocks[idx];
+	memset(block, 0, offsetof(history_block_t, words));
+	memset(block->words, 0, sizeof(block->words));
+	series->count++;
+
+	return block;
+}
+
+
+static void flushPending(history_ctx_t *ctx, history_series_t *series, int32_t now)
+{
+	history_block_t *block = NULL;
+
+	if (series->count > 0) {
+		block = blockAt(ctx, series, series->count - 1);
+		if (block->bits + HISTORY_MAX_POINT_BITS > HISTORY_BLOCK_BITS) {
+			block = NULL;
+		}
+	}
+
+	if (block == NULL) {
+		block = appendBlock(ctx, series);
+		if (block == NULL) {
+			return;
+		}
+	}
+
+	encodePoint(block, series->pendingTime, series->pendingValue);
+
+	/* Blocks which ended before the retention window are dropped, the newest one stays */
+	while (series->count > 1 && blockAt(ctx, series, 0)->last < now - ctx->retention) {
+		series->head = (series->head + 1) % ctx->capacity;
+		series->count--;
+	}
+}
+
+
+int history_init(history_ctx_t *ctx, const metersim_config_t *cfg)
+{
+	const uint32_t pointsPerBlock = (HISTORY_BLOCK_BITS - HISTORY_FIRST_POINT_BITS) / HISTORY_MAX_POINT_BITS + 1;
+
+	memset(ctx, 0, sizeof(*ctx));
+
+	if (cfg->historyRetention == 0) {
+		return 0;
+	}
+
+	ctx->retention = cfg->historyRetention;
+	ctx->capacity = (uint32_t)ctx->retention / pointsPerBlock + 2;
+
+	for (int field = 0; field < METERSIM_HISTORY_FIELDS; field++) {
+		ctx->series[field].blocks = calloc(ctx->capacity, sizeof(history_block_t *));
+		if (ctx->series[field].blocks == NULL) {
+			log_error("Could not allocate memory for history");
+			history_destroy(ctx);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+void history_reset(history_ctx_t *ctx)
+{
+	for (int field = 0; field < METERSIM_HISTORY_FIELDS; field++) {
+		ctx->series[field].head = 0;
+		ctx->series[field].count = 0;
+		ctx->series[field].pending = false;
+	}
+}
+
+
+int history_clone(history_ctx_t *dst, const history_ctx_t *src)
+{
+	history_series_t *series;
+
+	*dst = *src;
+	if (src->retention == 0) {
+		return 0;
+	}
+
+	for (int field = 0; field < METERSIM_HISTORY_FIELDS; field++) {
+		dst->series[field].blocks = NULL;
+	}
+
+	for (int field = 0; field < METERSIM_HISTORY_FIELDS; field++) {
+		series = &dst->series[field];
+		series->blocks = calloc(src->capacity, sizeof(history_block_t *));
+		if (series->blocks == NULL) {
+			history_destroy(dst);
+			return -1;
+		}
+
+		for (uint32_t i = 0; i < src->capacity; i++) {
+			if (src->series[field].blocks[i] == NULL) {
+				continue;
+			}
+			series->blocks[i] = malloc(sizeof(history_block_t));
+			if (series->blocks[i] == NULL) {
+				log_error("Could not allocate memory for history");
+				history_destroy(dst);
+				return -1;
+			}
+			*series->blocks[i] = *src->series[field].blocks[i];
+		}
+	}
+
+	return 0;
+}
+
+
+void history_destroy(history_ctx_t *ctx)
+{
+	for (int field = 0; field < METERSIM_HISTORY_FIELDS; field++) {
+		if (ctx->series[field].blocks == NULL) {
+			continue;
+		}
+		for (uint32_t i = 0; i < ctx->capacity; i++) {
+			free(ctx->series[field].blocks[i]);
+		}
+		free(ctx->series[field].blocks);
+		ctx->series[field].blocks = NULL;
+	}
+}
+
+
+void history_record(history_ctx_t *ctx, const metersim_state_t *state, int32_t now)
+{
+	history_series_t *series;
+	double value;
+
+	if (ctx->retention == 0) {
+		return;
+	}
+
+	for (int field = 0; field < METERSIM_HISTORY_FIELDS; field++) {
+		series = &ctx->series[field];
+		value = getField(state, field);
+
+		if (series->pending) {
+			if (doubleToBits(value) == doubleToBits(series->pendingValue)) {
+				continue;
+			}
+			if (series->pendingTime != now) {
+				flushPending(ctx, series, now);
+			}
+		}
+
+		series->pending = true;
+		series->pendingTime = now;
+		series->pendingValue = value;
+	}
+}
+
+
+size_t history_query(history_ctx_t *ctx, int field, int32_t from, int32_t to, metersim_historyPoint_t *buf, size_t n)
+{
+	history_series_t *series = &ctx->series[field];
+	history_reader_t r;
+	const history_block_t *block;
+	size_t copied = 0;
+
+	if (ctx->retention == 0) {
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < series->count && copied < n; i++) {
+		block = blockAt(ctx, series, i);
+		if (block->last < from) {
+			continue;
+		}
+		if (block->first > to) {
+			return copied;
+		}
+
+		r = (history_reader_t) { .block = block };
+		while (r.index < block->count && copied < n) {
+			decodePoint(&r);
+			if (r.time > to) {
+				return copied;
+			}
+			if (r.time >= from) {
+				buf[copied++] = (metersim_historyPoint_t) { .timestamp = r.time, .value = bitsToDouble(r.value) };
+			}
+		}
+	}
+
+	if (series->pending && copied < n && series->pendingTime >= from && series->pendingTime <= to) {
+		buf[copied++] = (metersim_historyPoint_t) { .timestamp = series->pendingTime, .value = series->pendingValue };
+	}
+
+	return copied;
+}
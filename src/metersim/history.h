@@ -0,0 +1,81 @@
+/*
+ * Compressed history of the SEM simulator state
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+
+#define HISTORY_BLOCK_WORDS 512 /* 4 KiB of compressed points */
+
+
+/*
+ * Points are compressed as in Gorilla: delta-of-delta timestamps and values XORed with the previous one.
+ * Each block starts with an uncompressed point, so it can be decoded on its own.
+ */
+typedef struct {
+	int32_t first; /* timestamp of the first point */
+	int32_t last;  /* timestamp of the last point */
+	uint32_t count;
+	uint32_t bits; /* bits used in `words` */
+
+	/* Encoder state after the last point */
+	int32_t lastDelta;
+	uint64_t lastValue;
+	uint8_t leading;
+	uint8_t trailing;
+
+	uint64_t words[HISTORY_BLOCK_WORDS];
+} history_block_t;
+
+
+typedef struct {
+	history_block_t **blocks; /* ring of blocks from the oldest, allocated on first use */
+	uint32_t head;
+	uint32_t count;
+
+	/* The newest point is kept uncompressed, as it may be replaced within the same second */
+	bool pending;
+	int32_t pendingTime;
+	double pendingValue;
+} history_series_t;
+
+
+typedef struct {
+	int32_t retention; /* (s) 0 if the history is disabled */
+	uint32_t capacity; /* blocks per series, enough for a point every second over the retention */
+	history_series_t series[METERSIM_HISTORY_FIELDS];
+} history_ctx_t;
+
+
+int history_init(history_ctx_t *ctx, const metersim_config_t *cfg);
+
+
+/* Drops all points, keeps the allocated blocks */
+void history_reset(history_ctx_t *ctx);
+
+
+int history_clone(history_ctx_t *dst, const history_ctx_t *src);
+
+
+void history_destroy(history_ctx_t *ctx);
+
+
+/* Records the values of the state which changed at `now` */
+void history_record(history_ctx_t *ctx, const metersim_state_t *state, int32_t now);
+
+
+size_t history_query(history_ctx_t *ctx, int field, int32_t from, int32_t to, metersim_historyPoint_t *buf, size_t n);
+
+#endif /* HISTORY_H */
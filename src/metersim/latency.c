@@ -0,0 +1,52 @@
+/*
+ * Latency histograms
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#include <metersim/metersim_types.h>
+#include "latency.h"
+
+#define NSEC_PER_SEC  (1000 * 1000 * 1000)
+#define NSEC_PER_USEC 1000
+
+
+void latency_init(metersim_latency_t *hist)
+{
+	*hist = (metersim_latency_t) { 0 };
+}
+
+
+void latency_record(metersim_latency_t *hist, int64_t nsec)
+{
+	int64_t usec;
+	int bucket = 0;
+
+	if (nsec < 0) {
+		nsec = 0;
+	}
+
+	/* Buckets grow by powers of two of microseconds */
+	for (usec = nsec / NSEC_PER_USEC; usec > 0 && bucket < METERSIM_LATENCY_BUCKETS - 1; usec >>= 1) {
+		bucket++;
+	}
+
+	hist->count[bucket]++;
+	hist->samples++;
+	hist->sum += nsec;
+	if (nsec > hist->max) {
+		hist->max = nsec;
+	}
+}
+
+
+int64_t latency_elapsed(const struct timespec *from, const struct timespec *to)
+{
+	return (int64_t)(to->tv_sec - from->tv_sec) * NSEC_PER_SEC + (to->tv_nsec - from->tv_nsec);
+}
@@ -0,0 +1,29 @@
+/*
+ * Latency histograms
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <metersim/metersim_types.h>
+
+
+void latency_init(metersim_latency_t *hist);
+
+
+/* Records a latency of `nsec` nanoseconds, negative ones count as 0 */
+void latency_record(metersim_latency_t *hist, int64_t nsec);
+
+
+/* Returns `to - from` in nanoseconds */
+int64_t latency_elapsed(const struct timespec *from, const struct timespec *to);
+
+#endif /* LATENCY_H */
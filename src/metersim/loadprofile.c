@@ -0,0 +1,174 @@
+/*
+ * Load profile of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "loadprofile.h"
+#include "log.h"
+
+#define LOG_TAG "loadprofile : "
+
+
+static void clearIntegrals(loadprofile_ctx_t *ctx)
+{
+	ctx->frequency = 0;
+	for (int i = 0; i < 3; i++) {
+		ctx->voltage[i] = 0;
+		ctx->current[i] = 0;
+	}
+	ctx->elapsed = 0;
+}
+
+
+/* Returns i-th oldest entry */
+static inline metersim_profileEntry_t *entryAt(loadprofile_ctx_t *ctx, uint32_t i)
+{
+	return &ctx->entries[(ctx->head + ctx->capacity - ctx->count + i) % ctx->capacity];
+}
+
+
+int loadprofile_init(loadprofile_ctx_t *ctx, const metersim_config_t *cfg)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->nextCapture = METERSIM_NO_UPDATE_SCHEDULED;
+
+	if (cfg->loadProfilePeriod == 0 || cfg->loadProfileCapacity == 0) {
+		return 0;
+	}
+
+	ctx->entries = malloc(cfg->loadProfileCapacity * sizeof(metersim_profileEntry_t));
+	if (ctx->entries == NULL) {
+		log_error("Could not allocate memory for load profile");
+		return -1;
+	}
+
+	ctx->period = cfg->loadProfilePeriod;
+	ctx->capacity = cfg->loadProfileCapacity;
+	ctx->nextCapture = ctx->period;
+
+	return 0;
+}
+
+
+void loadprofile_reset(loadprofile_ctx_t *ctx)
+{
+	ctx->nextCapture = ctx->period != 0 ? ctx->period : METERSIM_NO_UPDATE_SCHEDULED;
+	ctx->frequency = 0;
+	memset(ctx->voltage, 0, sizeof(ctx->voltage));
+	memset(ctx->current, 0, sizeof(ctx->current));
+	ctx->elapsed = 0;
+	ctx->head = 0;
+	ctx->count = 0;
+}
+
+
+int loadprofile_clone(loadprofile_ctx_t *dst, const loadprofile_ctx_t *src)
+{
+	*dst = *src;
+	if (src->entries == NULL) {
+		return 0;
+	}
+
+	dst->entries = malloc(src->capacity * sizeof(metersim_profileEntry_t));
+	if (dst->entries == NULL) {
+		log_error("Could not allocate memory for load profile");
+		return -1;
+	}
+	memcpy(dst->entries, src->entries, src->capacity * sizeof(metersim_profileEntry_t));
+
+	return 0;
+}
+
+
+void loadprofile_destroy(loadprofile_ctx_t *ctx)
+{
+	free(ctx->entries);
+	ctx->entries = NULL;
+}
+
+
+void loadprofile_accumulate(loadprofile_ctx_t *ctx, const metersim_state_t *state, int32_t dt)
+{
+	if (ctx->period == 0) {
+		return;
+	}
+
+	ctx->frequency += (double)state->instant.frequency * dt;
+	for (int i = 0; i < 3; i++) {
+		ctx->voltage[i] += state->instant.voltage[i] * dt;
+		ctx->current[i] += state->instant.current[i] * dt;
+	}
+	ctx->elapsed += dt;
+}
+
+
+int32_t loadprofile_getNextCapture(loadprofile_ctx_t *ctx)
+{
+	return ctx->nextCapture;
+}
+
+
+void loadprofile_capture(loadprofile_ctx_t *ctx, int32_t now, const metersim_energy_t *total)
+{
+	metersim_profileEntry_t *entry;
+
+	assert(now == ctx->nextCapture);
+	assert(ctx->elapsed == ctx->period);
+
+	/* When the ring is full the oldest entry is overwritten */
+	entry = &ctx->entries[ctx->head];
+	ctx->head = (ctx->head + 1) % ctx->capacity;
+	if (ctx->count < ctx->capacity) {
+		ctx->count++;
+	}
+
+	entry->timestamp = now;
+	entry->energy = *total;
+	entry->frequency = (float)(ctx->frequency / ctx->period);
+	for (int i = 0; i < 3; i++) {
+		entry->voltage[i] = ctx->voltage[i] / ctx->period;
+		entry->current[i] = ctx->current[i] / ctx->period;
+	}
+
+	clearIntegrals(ctx);
+	ctx->nextCapture += ctx->period;
+}
+
+
+size_t loadprofile_query(loadprofile_ctx_t *ctx, int32_t from, int32_t to, metersim_profileEntry_t *buf, size_t n)
+{
+	uint32_t lo = 0, hi = ctx->count, mid;
+	size_t copied = 0;
+
+	/* Entries are sorted by timestamp, find the first one not older than `from` */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (entryAt(ctx, mid)->timestamp < from) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	for (uint32_t i = lo; i < ctx->count && copied < n; i++) {
+		metersim_profileEntry_t *entry = entryAt(ctx, i);
+		if (entry->timestamp > to) {
+			break;
+		}
+		buf[copied++] = *entry;
+	}
+
+	return copied;
+}
@@ -0,0 +1,66 @@
+/*
+ * Load profile of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef LOADPROFILE_H
+#define LOADPROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+
+
+typedef struct {
+	int32_t period; /* (s) capture period, 0 if load profile is disabled */
+	int32_t nextCapture;
+
+	/* Time integrals of the instant values over the current period */
+	double frequency;
+	double voltage[3];
+	double current[3];
+	int32_t elapsed;
+
+	/* Ring of captured entries, allocated once at initialization */
+	metersim_profileEntry_t *entries;
+	uint32_t capacity;
+	uint32_t head;
+	uint32_t count;
+} loadprofile_ctx_t;
+
+
+int loadprofile_init(loadprofile_ctx_t *ctx, const metersim_config_t *cfg);
+
+
+/* Drops captured entries and restarts the period, keeps the allocated ring */
+void loadprofile_reset(loadprofile_ctx_t *ctx);
+
+
+int loadprofile_clone(loadprofile_ctx_t *dst, const loadprofile_ctx_t *src);
+
+
+void loadprofile_destroy(loadprofile_ctx_t *ctx);
+
+
+/* Integrates instant values over a segment of constant state. The segment must not cross the capture time. */
+void loadprofile_accumulate(loadprofile_ctx_t *ctx, const metersim_state_t *state, int32_t dt);
+
+
+/* Returns uptime of the next capture */
+int32_t loadprofile_getNextCapture(loadprofile_ctx_t *ctx);
+
+
+/* Stores the entry closing the current period */
+void loadprofile_capture(loadprofile_ctx_t *ctx, int32_t now, const metersim_energy_t *total);
+
+
+/* Copies entries with timestamps in [from, to] to `buf`. Returns the number of copied entries. */
+size_t loadprofile_query(loadprofile_ctx_t *ctx, int32_t from, int32_t to, metersim_profileEntry_t *buf, size_t n);
+
+#endif /* LOADPROFILE_H */
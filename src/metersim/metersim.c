@@ -12,6 +12,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "time_machine.h"
 #include "simulator.h"
@@ -19,6 +20,9 @@
 #include <metersim/metersim_types.h>
 #include "metersim_types_int.h"
 #include "runner.h"
+#include "runner_group.h"
+#include "clocksrc.h"
+#include "statefile.h"
 
 
 struct metersim_ctx_s {
@@ -46,6 +50,69 @@ metersim_ctx_t *metersim_init(const char *dir)
 }
 
 
+metersim_ctx_t *metersim_loadState(const char *dir, const char *path)
+{
+	metersim_ctx_t *ctx = metersim_init(dir);
+	if (ctx == NULL) {
+		return NULL;
+	}
+
+	if (statefile_load(ctx->simulator, path) < 0) {
+		metersim_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+
+int metersim_saveState(metersim_ctx_t *ctx, const char *path)
+{
+	uint16_t speedup = ctx->simulator->state.cfg.speedup;
+
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+		speedup = runner_getSpeedup(ctx->runner);
+	}
+
+	return statefile_save(ctx->simulator, speedup, path) < 0 ? METERSIM_ERROR : METERSIM_SUCCESS;
+}
+
+
+int metersim_reset(metersim_ctx_t *ctx)
+{
+	/* The runner keeps its own clock, so it has to be destroyed first */
+	if (ctx->runner != NULL) {
+		return METERSIM_REFUSE;
+	}
+
+	simulator_reset(ctx->simulator);
+	return METERSIM_SUCCESS;
+}
+
+
+metersim_ctx_t *metersim_clone(metersim_ctx_t *ctx)
+{
+	metersim_ctx_t *clone = malloc(sizeof(metersim_ctx_t));
+	if (clone == NULL) {
+		return NULL;
+	}
+
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+
+	clone->simulator = simulator_clone(ctx->simulator);
+	if (clone->simulator == NULL) {
+		free(clone);
+		return NULL;
+	}
+
+	clone->runner = NULL;
+	return clone;
+}
+
+
 void metersim_free(metersim_ctx_t *ctx)
 {
 	simulator_destroy(ctx->simulator);
@@ -54,6 +121,12 @@ void metersim_free(metersim_ctx_t *ctx)
 
 
 int metersim_createRunner(metersim_ctx_t *ctx, int start)
+{
+	return metersim_createRunnerWithOpts(ctx, start, NULL);
+}
+
+
+int metersim_createRunnerWithOpts(metersim_ctx_t *ctx, int start, const metersim_runnerOpts_t *opts)
 {
 	if (ctx->runner != NULL) {
 		return METERSIM_ERROR;
@@ -64,6 +137,12 @@ int metersim_createRunner(metersim_ctx_t *ctx, int start)
 		return METERSIM_ERROR;
 	}
 
+	if (opts != NULL && runner_setOpts(ctx->runner, opts) < 0) {
+		runner_destroy(ctx->runner);
+		ctx->runner = NULL;
+		return METERSIM_ERROR;
+	}
+
 	/* Pause immediately if start == 0 */
 	if (start == 0) {
 		runner_pause(ctx->runner, 0);
@@ -71,6 +150,7 @@ int metersim_createRunner(metersim_ctx_t *ctx, int start)
 
 	if (runner_start(ctx->runner) < 0) {
 		runner_destroy(ctx->runner);
+		ctx->runner = NULL;
 		return METERSIM_ERROR;
 	}
 
@@ -91,6 +171,63 @@ int metersim_createRunnerWithCb(metersim_ctx_t *ctx, uint64_t (*getTimeCb)(void
 
 	if (runner_start(ctx->runner) < 0) {
 		runner_destroy(ctx->runner);
+		ctx->runner = NULL;
+		return METERSIM_ERROR;
+	}
+
+	return METERSIM_SUCCESS;
+}
+
+
+int metersim_createLazyRunner(metersim_ctx_t *ctx, int start)
+{
+	return metersim_createLazyRunnerWithClock(ctx, start, NULL);
+}
+
+
+int metersim_createLazyRunnerWithClock(metersim_ctx_t *ctx, int start, metersim_clock_t *clock)
+{
+	if (ctx->runner != NULL) {
+		return METERSIM_ERROR;
+	}
+
+	ctx->runner = runner_initLazy(ctx->simulator, clock);
+	if (ctx->runner == NULL) {
+		return METERSIM_ERROR;
+	}
+
+	if (start == 0) {
+		runner_pause(ctx->runner, 0);
+	}
+
+	if (runner_start(ctx->runner) < 0) {
+		runner_destroy(ctx->runner);
+		ctx->runner = NULL;
+		return METERSIM_ERROR;
+	}
+
+	return METERSIM_SUCCESS;
+}
+
+
+int metersim_createPushedRunner(metersim_ctx_t *ctx, int64_t nowUtc)
+{
+	if (ctx->runner != NULL) {
+		return METERSIM_ERROR;
+	}
+
+	if (simulator_hasPausingWatchpoint(ctx->simulator)) {
+		return METERSIM_REFUSE;
+	}
+
+	ctx->runner = runner_initPushed(ctx->simulator, nowUtc);
+	if (ctx->runner == NULL) {
+		return METERSIM_ERROR;
+	}
+
+	if (runner_start(ctx->runner) < 0) {
+		runner_destroy(ctx->runner);
+		ctx->runner = NULL;
 		return METERSIM_ERROR;
 	}
 
@@ -98,6 +235,96 @@ int metersim_createRunnerWithCb(metersim_ctx_t *ctx, uint64_t (*getTimeCb)(void
 }
 
 
+int metersim_advanceTime(metersim_ctx_t *ctx, int64_t utc, int64_t *nextUtc)
+{
+	if (ctx->runner == NULL) {
+		return METERSIM_ERROR;
+	}
+
+	return runner_advanceTime(ctx->runner, utc, nextUtc) < 0 ? METERSIM_ERROR : METERSIM_SUCCESS;
+}
+
+
+int metersim_createGroupRunner(metersim_ctx_t *ctx, metersim_group_t *group)
+{
+	if (ctx->runner != NULL) {
+		return METERSIM_ERROR;
+	}
+
+	if (simulator_hasPausingWatchpoint(ctx->simulator)) {
+		return METERSIM_REFUSE;
+	}
+
+	ctx->runner = runner_initGroup(ctx->simulator, group);
+	if (ctx->runner == NULL) {
+		return METERSIM_ERROR;
+	}
+
+	if (runner_start(ctx->runner) < 0) {
+		runner_destroy(ctx->runner);
+		ctx->runner = NULL;
+		return METERSIM_ERROR;
+	}
+
+	return METERSIM_SUCCESS;
+}
+
+
+metersim_clock_t *metersim_clockInit(void)
+{
+	return clocksrc_initManual();
+}
+
+
+void metersim_clockFree(metersim_clock_t *clock)
+{
+	clocksrc_destroy(clock);
+}
+
+
+int metersim_clockAdvance(metersim_clock_t *clock, int64_t nsec)
+{
+	if (nsec < 0) {
+		return METERSIM_ERROR;
+	}
+
+	clocksrc_advance(clock, nsec);
+	return METERSIM_SUCCESS;
+}
+
+
+metersim_group_t *metersim_groupInit(uint16_t speedup, metersim_clock_t *clock)
+{
+	if (speedup < 1 || speedup > METERSIM_MAX_SPEEDUP) {
+		return NULL;
+	}
+
+	return runnerGroup_init(speedup, clock);
+}
+
+
+int metersim_groupFree(metersim_group_t *group)
+{
+	if (runnerGroup_count(group) != 0) {
+		return METERSIM_REFUSE;
+	}
+
+	runnerGroup_destroy(group);
+	return METERSIM_SUCCESS;
+}
+
+
+int metersim_groupSetSpeedup(metersim_group_t *group, uint16_t speedup)
+{
+	if (speedup < 1 || speedup > METERSIM_MAX_SPEEDUP) {
+		return METERSIM_ERROR;
+	}
+
+	runnerGroup_setSpeedup(group, speedup);
+	return METERSIM_SUCCESS;
+}
+
+
 void metersim_destroyRunner(metersim_ctx_t *ctx)
 {
 	if (ctx->runner == NULL) {
@@ -114,6 +341,9 @@ int metersim_resume(metersim_ctx_t *ctx)
 	if (ctx->runner == NULL) {
 		return METERSIM_ERROR;
 	}
+	if (runner_isDriven(ctx->runner)) {
+		return METERSIM_REFUSE;
+	}
 	runner_update(ctx->runner);
 	runner_resume(ctx->runner);
 	return METERSIM_SUCCESS;
@@ -125,12 +355,101 @@ int metersim_pause(metersim_ctx_t *ctx, int32_t when)
 	if (ctx->runner == NULL) {
 		return METERSIM_ERROR;
 	}
+	if (runner_isDriven(ctx->runner)) {
+		return METERSIM_REFUSE;
+	}
 	runner_update(ctx->runner);
 	runner_pause(ctx->runner, when);
 	return METERSIM_SUCCESS;
 }
 
 
+int metersim_addWatchpoint(metersim_ctx_t *ctx, int type, double threshold, void (*callback)(int, int32_t, void *), void *callbackCtx)
+{
+	int ret;
+
+	/* A pushed or group clock cannot be paused by a watchpoint */
+	if (callback == NULL && ctx->runner != NULL && runner_isDriven(ctx->runner)) {
+		return METERSIM_REFUSE;
+	}
+
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+
+	ret = simulator_addWatchpoint(ctx->simulator, type, threshold, callback, callbackCtx);
+
+	/* Runner has to reschedule its wakeup for a possible energy crossing */
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+	return ret;
+}
+
+
+int metersim_removeWatchpoint(metersim_ctx_t *ctx, int id)
+{
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+
+	return simulator_removeWatchpoint(ctx->simulator, id);
+}
+
+
+static int subscribe(metersim_ctx_t *ctx, unsigned int fields, const metersim_deadband_t *deadband,
+	void (*callback)(int, unsigned int, int32_t, void *), void *callbackCtx, int fd)
+{
+	int ret;
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+
+	ret = simulator_subscribe(ctx->simulator, fields, deadband, callback, callbackCtx, fd);
+
+	/* Runner has to reschedule its wakeup for the next energy boundary */
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+	return ret;
+}
+
+
+int metersim_subscribe(metersim_ctx_t *ctx, unsigned int fields, const metersim_deadband_t *deadband,
+	void (*callback)(int, unsigned int, int32_t, void *), void *callbackCtx)
+{
+	if (callback == NULL) {
+		return METERSIM_ERROR;
+	}
+
+	return subscribe(ctx, fields, deadband, callback, callbackCtx, -1);
+}
+
+
+int metersim_subscribeFd(metersim_ctx_t *ctx, unsigned int fields, const metersim_deadband_t *deadband, int fd)
+{
+	int flags;
+
+	/* Notifications are written with the simulator locked, so a reader falling behind must not block them */
+	flags = fd < 0 ? -1 : fcntl(fd, F_GETFL);
+	if (flags < 0 || (flags & O_NONBLOCK) == 0) {
+		return METERSIM_ERROR;
+	}
+
+	return subscribe(ctx, fields, deadband, NULL, NULL, fd);
+}
+
+
+int metersim_unsubscribe(metersim_ctx_t *ctx, int id)
+{
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+
+	return simulator_unsubscribe(ctx->simulator, id);
+}
+
+
 int metersim_isRunning(metersim_ctx_t *ctx)
 {
 	if (ctx->runner == NULL) {
@@ -151,6 +470,10 @@ int metersim_setSpeedup(metersim_ctx_t *ctx, uint16_t speedup)
 		return METERSIM_ERROR;
 	}
 
+	if (runner_isDriven(ctx->runner)) {
+		return METERSIM_REFUSE;
+	}
+
 	runner_update(ctx->runner);
 	runner_setSpeedup(ctx->runner, speedup);
 	runner_update(ctx->runner);
@@ -158,6 +481,17 @@ int metersim_setSpeedup(metersim_ctx_t *ctx, uint16_t speedup)
 }
 
 
+int metersim_getLatency(metersim_ctx_t *ctx, int kind, metersim_latency_t *ret)
+{
+	if (ctx->runner == NULL || kind < 0 || kind >= METERSIM_LATENCY_KINDS) {
+		return METERSIM_ERROR;
+	}
+
+	runner_getLatency(ctx->runner, kind, ret);
+	return METERSIM_SUCCESS;
+}
+
+
 int metersim_stepForward(metersim_ctx_t *ctx, uint32_t seconds)
 {
 	/* Stepping forward is allowed only when there is no runner and when it is paused */
@@ -170,6 +504,21 @@ int metersim_stepForward(metersim_ctx_t *ctx, uint32_t seconds)
 }
 
 
+int metersim_stepAndSample(metersim_ctx_t *ctx, uint32_t seconds, uint32_t interval, unsigned int fields, metersim_sample_t *buf, size_t n)
+{
+	if (interval == 0 || seconds > INT32_MAX || (size_t)(seconds / interval) > n) {
+		return METERSIM_ERROR;
+	}
+
+	/* The same constraint as for metersim_stepForward */
+	if (ctx->runner != NULL && runner_isRunning(ctx->runner)) {
+		return METERSIM_REFUSE;
+	}
+
+	return simulator_stepAndSample(ctx->simulator, seconds, interval, fields, buf);
+}
+
+
 int metersim_newDevice(metersim_ctx_t *ctx, void (*callback)(metersim_infoForDevice_t *, metersim_deviceResponse_t *, void *), void *callbackCtx)
 {
 	int ret;
@@ -250,6 +599,18 @@ void metersim_getTimeUTC(metersim_ctx_t *ctx, int64_t *retTime)
 }
 
 
+void metersim_getStartTimeUTC(metersim_ctx_t *ctx, int64_t *retTime)
+{
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+		*retTime = runner_getStartUtc(ctx->runner);
+	}
+	else {
+		*retTime = ctx->simulator->state.cfg.startTime;
+	}
+}
+
+
 void metersim_setTimeUTC(metersim_ctx_t *ctx, int64_t time)
 {
 	if (ctx->runner != NULL) {
@@ -324,6 +685,69 @@ int metersim_getEnergyTariff(metersim_ctx_t *ctx, metersim_energy_t ret[3], int
 }
 
 
+int metersim_getDemand(metersim_ctx_t *ctx, metersim_demand_t *ret, int idxTariff)
+{
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+	return simulator_getDemand(ctx->simulator, ret, idxTariff);
+}
+
+
+size_t metersim_getLoadProfile(metersim_ctx_t *ctx, int32_t from, int32_t to, metersim_profileEntry_t *buf, size_t n)
+{
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+	return simulator_getLoadProfile(ctx->simulator, from, to, buf, n);
+}
+
+
+int metersim_queryHistory(metersim_ctx_t *ctx, int field, int32_t from, int32_t to, metersim_historyPoint_t *buf, size_t n)
+{
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+	return simulator_queryHistory(ctx->simulator, field, from, to, buf, n);
+}
+
+
+int metersim_getPqStats(metersim_ctx_t *ctx, metersim_pqStats_t *ret, int window)
+{
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+	return simulator_getPqStats(ctx->simulator, ret, window);
+}
+
+
+int metersim_readWaveform(metersim_ctx_t *ctx, metersim_waveform_t *ret)
+{
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+	return simulator_readWaveform(ctx->simulator, ret);
+}
+
+
+size_t metersim_readPqEvents(metersim_ctx_t *ctx, metersim_pqEvent_t *buf, size_t n)
+{
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+	return simulator_readPqEvents(ctx->simulator, buf, n);
+}
+
+
+size_t metersim_readPulses(metersim_ctx_t *ctx, metersim_pulse_t *buf, size_t n)
+{
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+	return simulator_readPulses(ctx->simulator, buf, n);
+}
+
+
 void metersim_getPower(metersim_ctx_t *ctx, metersim_power_t *ret)
 {
 	if (ctx->runner != NULL) {
@@ -349,3 +773,12 @@ void metersim_getThd(metersim_ctx_t *ctx, metersim_thd_t *ret)
 	}
 	simulator_getThd(ctx->simulator, ret);
 }
+
+
+void metersim_getSnapshot(metersim_ctx_t *ctx, unsigned int fields, metersim_snapshot_t *ret)
+{
+	if (ctx->runner != NULL) {
+		runner_update(ctx->runner);
+	}
+	simulator_getSnapshot(ctx->simulator, fields, ret);
+}
@@ -15,6 +15,29 @@
 
 #include <metersim/metersim_types.h>
 
+typedef struct {
+	double nominalVoltage;        /* (V) 0 disables the detection of voltage events */
+	double sagThreshold;          /* fractions of the nominal voltage */
+	double swellThreshold;
+	double interruptionThreshold;
+	double thdUThreshold;         /* 0 disables the detection, 0.08 if the scenario has [powerQuality] */
+	double thdIThreshold;
+} metersim_pqConfig_t;
+
+
+#ifdef METERSIM_ERROR_MODEL
+typedef struct {
+	uint64_t seed;
+	double voltageGain;       /* maximum relative gain error of voltage channels */
+	double currentGain;       /* maximum relative gain error of current channels */
+	double phaseError;        /* (degrees) maximum phase error between voltage and current */
+	double noise;             /* relative standard deviation of the noise of returned values */
+	double voltageResolution; /* (V) quantization step, 0 disables quantization */
+	double currentResolution; /* (A) */
+} metersim_errorConfig_t;
+#endif
+
+
 typedef struct {
 	char serialNumber[METERSIM_MAX_SERIAL_NUMBER_LENGTH];
 	int64_t startTime;
@@ -22,6 +45,17 @@ typedef struct {
 	uint8_t phaseCount;
 	unsigned int meterConstant;
 	uint16_t speedup;
+	int32_t demandPeriod; /* (s) */
+	uint8_t demandSubperiods;
+	int32_t loadProfilePeriod; /* (s) */
+	uint32_t loadProfileCapacity;
+	metersim_pqConfig_t pq;
+	uint32_t waveformSampleRate; /* (Hz) */
+	uint32_t pulseBufferSize;
+	int32_t historyRetention; /* (s) */
+#ifdef METERSIM_ERROR_MODEL
+	metersim_errorConfig_t error;
+#endif
 } metersim_config_t;
 
 
@@ -31,9 +65,19 @@ typedef struct {
 } metersim_scenario_t;
 
 
+/* Groups of columns changed by an update */
+#define METERSIM_UPDATE_TARIFF    (1u << 0)
+#define METERSIM_UPDATE_FREQUENCY (1u << 1)
+#define METERSIM_UPDATE_THD       (1u << 2)
+#define METERSIM_UPDATE_VOLTAGE   (1u << 3)
+#define METERSIM_UPDATE_CURRENT   (1u << 4) /* current or ui angle */
+#define METERSIM_UPDATE_ALL       (0x1fu)
+
+
 typedef struct {
 	int32_t timestamp;
 	uint8_t currentTariff;
+	uint8_t changed; /* METERSIM_UPDATE_* differing from the previous update */
 
 	/* Data */
 	metersim_instant_t instant;
@@ -41,8 +85,13 @@ typedef struct {
 } metersim_update_t;
 
 
+/* Calculation kernels specialized for the configuration, defined by the calculator */
+struct calculator_kernels_s;
+
+
 typedef struct {
 	metersim_config_t cfg;
+	const struct calculator_kernels_s *kernels; /* selected by calculator_initScenario */
 
 	uint8_t currentTariff;
 
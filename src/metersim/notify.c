@@ -0,0 +1,231 @@
+/*
+ * Change notifications of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "calculator.h"
+#include "notify.h"
+#include "log.h"
+
+#define LOG_TAG "notify : "
+
+
+/* Returns METERSIM_NOTIFY_* of the quantities of `sub` outside of their deadbands */
+static unsigned int getChanged(const notify_sub_t *sub, const metersim_state_t *state)
+{
+	unsigned int changed = 0;
+
+	if ((sub->fields & METERSIM_NOTIFY_TARIFF) != 0 && state->currentTariff != sub->tariff) {
+		changed |= METERSIM_NOTIFY_TARIFF;
+	}
+
+	if ((sub->fields & METERSIM_NOTIFY_VOLTAGE) != 0) {
+		for (int i = 0; i < state->cfg.phaseCount; i++) {
+			if (fabs(state->instant.voltage[i] - sub->voltage[i]) > sub->deadband.voltage * fabs(sub->voltage[i])) {
+				changed |= METERSIM_NOTIFY_VOLTAGE;
+			}
+		}
+	}
+
+	if ((sub->fields & METERSIM_NOTIFY_POWER) != 0 && fabs(calculator_getTotalPower(state) - sub->power) > sub->deadband.power) {
+		changed |= METERSIM_NOTIFY_POWER;
+	}
+
+	if ((sub->fields & METERSIM_NOTIFY_ENERGY) != 0 && calculator_getActivePlus(state) / (int64_t)sub->deadband.energy != sub->boundary) {
+		changed |= METERSIM_NOTIFY_ENERGY;
+	}
+
+	return changed;
+}
+
+
+static void setReference(notify_sub_t *sub, const metersim_state_t *state, unsigned int fields)
+{
+	if ((fields & METERSIM_NOTIFY_TARIFF) != 0) {
+		sub->tariff = state->currentTariff;
+	}
+
+	if ((fields & METERSIM_NOTIFY_VOLTAGE) != 0) {
+		for (int i = 0; i < 3; i++) {
+			sub->voltage[i] = state->instant.voltage[i];
+		}
+	}
+
+	if ((fields & METERSIM_NOTIFY_POWER) != 0) {
+		sub->power = calculator_getTotalPower(state);
+	}
+
+	if ((fields & METERSIM_NOTIFY_ENERGY) != 0) {
+		sub->boundary = calculator_getActivePlus(state) / (int64_t)sub->deadband.energy;
+	}
+}
+
+
+/* Writes a 64-bit 1 to `fd` without raising SIGPIPE if its reader is closed */
+static ssize_t writeOne(int fd)
+{
+	static const uint64_t one = 1;
+	const struct timespec noWait = { 0 };
+	sigset_t pipeSet, oldSet, pending;
+	bool wasPending;
+	ssize_t ret;
+
+	ret = send(fd, &one, sizeof(one), MSG_NOSIGNAL);
+	if (ret >= 0 || errno != ENOTSOCK) {
+		return ret;
+	}
+
+	/* Pipes have no MSG_NOSIGNAL, so SIGPIPE is blocked for the write and a signal it raised is consumed */
+	sigemptyset(&pipeSet);
+	sigaddset(&pipeSet, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipeSet, &oldSet);
+	sigpending(&pending);
+	wasPending = sigismember(&pending, SIGPIPE) == 1;
+
+	ret = write(fd, &one, sizeof(one));
+	if (ret < 0 && errno == EPIPE && !wasPending) {
+		while (sigtimedwait(&pipeSet, NULL, &noWait) < 0 && errno == EINTR) {
+		}
+		errno = EPIPE;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+
+	return ret;
+}
+
+
+void notify_init(notify_ctx_t *ctx)
+{
+	for (int id = 0; id < METERSIM_MAX_SUBSCRIPTIONS; id++) {
+		ctx->subs[id].used = false;
+	}
+}
+
+
+int notify_add(notify_ctx_t *ctx, const metersim_state_t *state, unsigned int fields, const metersim_deadband_t *deadband,
+	void (*callback)(int, unsigned int, int32_t, void *), void *callbackCtx, int fd)
+{
+	notify_sub_t *sub;
+
+	if (fields == 0 || (fields & ~(METERSIM_NOTIFY_TARIFF | METERSIM_NOTIFY_VOLTAGE | METERSIM_NOTIFY_POWER | METERSIM_NOTIFY_ENERGY)) != 0) {
+		return -1;
+	}
+
+	if (!(deadband->voltage >= 0) || !(deadband->power >= 0) || ((fields & METERSIM_NOTIFY_ENERGY) != 0 && !(deadband->energy >= 1))) {
+		return -1;
+	}
+
+	if (callback == NULL && fd < 0) {
+		return -1;
+	}
+
+	for (int id = 0; id < METERSIM_MAX_SUBSCRIPTIONS; id++) {
+		sub = &ctx->subs[id];
+		if (sub->used) {
+			continue;
+		}
+
+		*sub = (notify_sub_t) {
+			.used = true,
+			.fields = fields,
+			.deadband = *deadband,
+			.callback = callback,
+			.callbackCtx = callbackCtx,
+			.fd = fd
+		};
+		setReference(sub, state, fields);
+
+		return id;
+	}
+
+	return -1;
+}
+
+
+int notify_remove(notify_ctx_t *ctx, int id)
+{
+	if (id < 0 || id >= METERSIM_MAX_SUBSCRIPTIONS || !ctx->subs[id].used) {
+		return -1;
+	}
+
+	ctx->subs[id].used = false;
+	return 0;
+}
+
+
+int32_t notify_getNextTime(notify_ctx_t *ctx, const metersim_state_t *state, int32_t now)
+{
+	int32_t res = METERSIM_NO_UPDATE_SCHEDULED;
+	double power = -1, dt;
+	int64_t energy = 0;
+	notify_sub_t *sub;
+
+	for (int id = 0; id < METERSIM_MAX_SUBSCRIPTIONS; id++) {
+		sub = &ctx->subs[id];
+		if (!sub->used || (sub->fields & METERSIM_NOTIFY_ENERGY) == 0) {
+			continue;
+		}
+
+		if (power < 0) {
+			power = calculator_getImportPower(state);
+			energy = calculator_getActivePlus(state);
+		}
+		if (power == 0) {
+			break;
+		}
+
+		/* Like energy crossing watchpoints, rounding is caught by a check one second later */
+		dt = ceil(((double)(sub->boundary + 1) * (double)(int64_t)sub->deadband.energy - (double)energy) / power);
+		dt = dt < 1 ? 1 : dt;
+		if (dt < (double)(res - now)) {
+			res = now + (int32_t)dt;
+		}
+	}
+
+	return res;
+}
+
+
+void notify_check(notify_ctx_t *ctx, const metersim_state_t *state, int32_t now)
+{
+	unsigned int changed;
+	notify_sub_t *sub;
+
+	for (int id = 0; id < METERSIM_MAX_SUBSCRIPTIONS; id++) {
+		sub = &ctx->subs[id];
+		if (!sub->used) {
+			continue;
+		}
+
+		changed = getChanged(sub, state);
+		if (changed == 0) {
+			continue;
+		}
+
+		setReference(sub, state, changed);
+		if (sub->callback != NULL) {
+			sub->callback(id, changed, now, sub->callbackCtx);
+		}
+		else if (writeOne(sub->fd) < 0) {
+			/* A full eventfd counter or pipe still wakes the reader up, a closed one is not waited for */
+			log_debug("Could not notify subscription %d: %s", id, strerror(errno));
+		}
+	}
+}
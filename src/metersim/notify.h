@@ -0,0 +1,60 @@
+/*
+ * Change notifications of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef NOTIFY_H
+#define NOTIFY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+
+
+typedef struct {
+	bool used;
+	unsigned int fields; /* METERSIM_NOTIFY_* */
+	metersim_deadband_t deadband;
+
+	/* Values at the last notification */
+	uint8_t tariff;
+	double voltage[3];
+	double power;
+	int64_t boundary; /* index of the last energy boundary reached */
+
+	void (*callback)(int, unsigned int, int32_t, void *); /* NULL if `fd` is written */
+	void *callbackCtx;
+	int fd;
+} notify_sub_t;
+
+
+typedef struct {
+	notify_sub_t subs[METERSIM_MAX_SUBSCRIPTIONS];
+} notify_ctx_t;
+
+
+void notify_init(notify_ctx_t *ctx);
+
+
+/* Returns id of the new subscription or -1. The reference values are taken from the current `state`. */
+int notify_add(notify_ctx_t *ctx, const metersim_state_t *state, unsigned int fields, const metersim_deadband_t *deadband,
+	void (*callback)(int, unsigned int, int32_t, void *), void *callbackCtx, int fd);
+
+
+int notify_remove(notify_ctx_t *ctx, int id);
+
+
+/* Returns the earliest time at which an energy boundary may be reached */
+int32_t notify_getNextTime(notify_ctx_t *ctx, const metersim_state_t *state, int32_t now);
+
+
+/* Notifies the subscribers of the quantities which left their deadbands and takes their values as the new references */
+void notify_check(notify_ctx_t *ctx, const metersim_state_t *state, int32_t now);
+
+#endif /* NOTIFY_H */
@@ -0,0 +1,116 @@
+/*
+ * Pool of SEM Simulator instances
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include <metersim/metersim.h>
+#include <metersim/metersim_types.h>
+#include "log.h"
+
+#define LOG_TAG "pool : "
+
+
+struct metersim_pool_s {
+	size_t size;
+	metersim_ctx_t **instances; /* all instances owned by the pool */
+	metersim_ctx_t **available; /* stack of instances ready to be acquired */
+	size_t availableCount;
+
+	pthread_mutex_t lock;
+};
+
+
+metersim_pool_t *metersim_poolInit(const char *dir, size_t size)
+{
+	metersim_pool_t *pool;
+
+	if (size == 0) {
+		return NULL;
+	}
+
+	pool = calloc(1, sizeof(metersim_pool_t));
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	pool->instances = calloc(size, sizeof(metersim_ctx_t *));
+	pool->available = calloc(size, sizeof(metersim_ctx_t *));
+	if (pool->instances == NULL || pool->available == NULL || pthread_mutex_init(&pool->lock, NULL) != 0) {
+		free(pool->available);
+		free(pool->instances);
+		free(pool);
+		return NULL;
+	}
+
+	pool->instances[0] = metersim_init(dir);
+	if (pool->instances[0] == NULL) {
+		metersim_poolFree(pool);
+		return NULL;
+	}
+	pool->size = 1;
+
+	/* Clones taken at t=0 share the parsed scenario */
+	for (size_t i = 1; i < size; i++) {
+		pool->instances[i] = metersim_clone(pool->instances[0]);
+		if (pool->instances[i] == NULL) {
+			log_error("Could not create pool instance");
+			metersim_poolFree(pool);
+			return NULL;
+		}
+		pool->size++;
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		pool->available[i] = pool->instances[i];
+	}
+	pool->availableCount = size;
+
+	return pool;
+}
+
+
+void metersim_poolFree(metersim_pool_t *pool)
+{
+	for (size_t i = 0; i < pool->size; i++) {
+		metersim_destroyRunner(pool->instances[i]);
+		metersim_free(pool->instances[i]);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->available);
+	free(pool->instances);
+	free(pool);
+}
+
+
+metersim_ctx_t *metersim_poolAcquire(metersim_pool_t *pool)
+{
+	metersim_ctx_t *ctx = NULL;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->availableCount > 0) {
+		ctx = pool->available[--pool->availableCount];
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return ctx;
+}
+
+
+void metersim_poolRelease(metersim_pool_t *pool, metersim_ctx_t *ctx)
+{
+	metersim_destroyRunner(ctx);
+	metersim_reset(ctx);
+
+	pthread_mutex_lock(&pool->lock);
+	pool->available[pool->availableCount++] = ctx;
+	pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,167 @@
+/*
+ * Power quality events detector of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "pqevent.h"
+#include "ring.h"
+#include "log.h"
+
+#define LOG_TAG "pqevent : "
+
+
+static void record(pqevent_ctx_t *ctx, uint8_t type, int8_t phase, pqevent_track_t *track, int32_t end)
+{
+	metersim_pqEvent_t ev = {
+		.type = type,
+		.phase = phase,
+		.start = track->start,
+		.end = end,
+		.extreme = track->extreme,
+	};
+
+	if (!ring_push(&ctx->log, &ev) && __atomic_load_n(&ctx->log.dropped, __ATOMIC_RELAXED) == 1) {
+		log_warning("Event log is full, events are dropped");
+	}
+}
+
+
+/*
+ * Updates tracking of a single event type. Starting events are recorded with end set
+ * to METERSIM_PQ_EVENT_ONGOING, finished ones with both start and end.
+ * `lowIsWorse` tells whether the extreme value is the minimum or the maximum.
+ */
+static void track(pqevent_ctx_t *ctx, uint8_t type, int8_t phase, bool condition, double value, bool lowIsWorse, int32_t now)
+{
+	pqevent_track_t *tr = &ctx->track[type][phase < 0 ? 0 : phase];
+
+	if (condition && !tr->active) {
+		tr->active = true;
+		tr->start = now;
+		tr->extreme = value;
+		record(ctx, type, phase, tr, METERSIM_PQ_EVENT_ONGOING);
+	}
+	else if (condition) {
+		if ((lowIsWorse && value < tr->extreme) || (!lowIsWorse && value > tr->extreme)) {
+			tr->extreme = value;
+		}
+	}
+	else if (tr->active) {
+		tr->active = false;
+		record(ctx, type, phase, tr, now);
+	}
+}
+
+
+static void checkThd(pqevent_ctx_t *ctx, const metersim_state_t *state, int32_t now)
+{
+	for (int8_t i = 0; i < state->cfg.phaseCount; i++) {
+		if (ctx->cfg.thdUThreshold > 0) {
+			track(ctx, METERSIM_PQ_THD_U, i, state->thd.thdU[i] > ctx->cfg.thdUThreshold, state->thd.thdU[i], false, now);
+		}
+		if (ctx->cfg.thdIThreshold > 0) {
+			track(ctx, METERSIM_PQ_THD_I, i, state->thd.thdI[i] > ctx->cfg.thdIThreshold, state->thd.thdI[i], false, now);
+		}
+	}
+}
+
+
+int pqevent_init(pqevent_ctx_t *ctx, const metersim_config_t *cfg)
+{
+	memset(ctx, 0, sizeof(*ctx));
+
+	/* THD checks do not need the nominal voltage, so either of them enables the detection */
+	if (cfg->pq.nominalVoltage <= 0 && cfg->pq.thdUThreshold <= 0 && cfg->pq.thdIThreshold <= 0) {
+		return 0;
+	}
+
+	if (ring_init(&ctx->log, sizeof(metersim_pqEvent_t), PQEVENT_RING_CAPACITY) < 0) {
+		log_error("Could not allocate memory for event log");
+		return -1;
+	}
+
+	ctx->cfg = cfg->pq;
+	ctx->enabled = true;
+
+	return 0;
+}
+
+
+void pqevent_reset(pqevent_ctx_t *ctx)
+{
+	memset(ctx->track, 0, sizeof(ctx->track));
+	if (ctx->enabled) {
+		ring_clear(&ctx->log);
+	}
+}
+
+
+void pqevent_destroy(pqevent_ctx_t *ctx)
+{
+	if (ctx->enabled) {
+		ring_destroy(&ctx->log);
+	}
+}
+
+
+void pqevent_check(pqevent_ctx_t *ctx, const metersim_state_t *state, int32_t now)
+{
+	const int phaseCount = state->cfg.phaseCount;
+	const double interruption = ctx->cfg.interruptionThreshold * ctx->cfg.nominalVoltage;
+	const double sag = ctx->cfg.sagThreshold * ctx->cfg.nominalVoltage;
+	const double swell = ctx->cfg.swellThreshold * ctx->cfg.nominalVoltage;
+
+	bool lost[3] = { false };
+	bool allLost = true;
+	double minVoltage = state->instant.voltage[0];
+
+	if (!ctx->enabled) {
+		return;
+	}
+
+	if (ctx->cfg.nominalVoltage <= 0) {
+		checkThd(ctx, state, now);
+		return;
+	}
+
+	for (int i = 0; i < phaseCount; i++) {
+		lost[i] = state->instant.voltage[i] < interruption;
+		allLost = allLost && lost[i];
+		if (state->instant.voltage[i] < minVoltage) {
+			minVoltage = state->instant.voltage[i];
+		}
+	}
+
+	/* Loss of all phases is an interruption, loss of some of them is a phase loss */
+	track(ctx, METERSIM_PQ_INTERRUPTION, METERSIM_PQ_ALL_PHASES, allLost, minVoltage, true, now);
+
+	for (int8_t i = 0; i < phaseCount; i++) {
+		double u = state->instant.voltage[i];
+
+		track(ctx, METERSIM_PQ_PHASE_LOSS, i, lost[i] && !allLost, u, true, now);
+		track(ctx, METERSIM_PQ_SAG, i, !lost[i] && u < sag, u, true, now);
+		track(ctx, METERSIM_PQ_SWELL, i, u > swell, u, false, now);
+	}
+
+	checkThd(ctx, state, now);
+}
+
+
+size_t pqevent_read(pqevent_ctx_t *ctx, metersim_pqEvent_t *buf, size_t n)
+{
+	if (!ctx->enabled) {
+		return 0;
+	}
+
+	return ring_pop(&ctx->log, buf, n);
+}
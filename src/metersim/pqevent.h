@@ -0,0 +1,59 @@
+/*
+ * Power quality events detector of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef PQEVENT_H
+#define PQEVENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "ring.h"
+
+#define PQEVENT_RING_CAPACITY 256
+
+
+typedef struct {
+	bool active;
+	int32_t start;
+	double extreme;
+} pqevent_track_t;
+
+
+typedef struct {
+	bool enabled;
+	metersim_pqConfig_t cfg;
+
+	/* Per phase tracking of the ongoing events, index 0 of METERSIM_PQ_INTERRUPTION is used for all phases */
+	pqevent_track_t track[METERSIM_PQ_EVENT_TYPES][3];
+
+	ring_t log;
+} pqevent_ctx_t;
+
+
+int pqevent_init(pqevent_ctx_t *ctx, const metersim_config_t *cfg);
+
+
+/* Forgets ongoing and logged events, keeps the allocated log */
+void pqevent_reset(pqevent_ctx_t *ctx);
+
+
+void pqevent_destroy(pqevent_ctx_t *ctx);
+
+
+/* Checks the state after an update against the thresholds. Called by the single producer. */
+void pqevent_check(pqevent_ctx_t *ctx, const metersim_state_t *state, int32_t now);
+
+
+/* Pops recorded events. Can be called concurrently with pqevent_check. */
+size_t pqevent_read(pqevent_ctx_t *ctx, metersim_pqEvent_t *buf, size_t n);
+
+#endif /* PQEVENT_H */
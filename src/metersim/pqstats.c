@@ -0,0 +1,207 @@
+/*
+ * Power quality aggregation of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "pqstats.h"
+
+
+static const int32_t windowLengths[METERSIM_PQ_WINDOW_COUNT] = {
+	[METERSIM_PQ_WINDOW_10MIN] = 10 * 60,
+	[METERSIM_PQ_WINDOW_2H] = 2 * 3600,
+};
+
+
+static void sketch_reset(pqstats_sketch_t *s)
+{
+	s->n = 0;
+	s->sum = 0;
+	s->total = 0;
+}
+
+
+static void sketch_add(pqstats_sketch_t *s, double value, double weight)
+{
+	int i, pos, merge;
+	double gap, minGap;
+
+	if (s->total == 0) {
+		s->min = value;
+		s->max = value;
+	}
+	else if (value < s->min) {
+		s->min = value;
+	}
+	else if (value > s->max) {
+		s->max = value;
+	}
+	s->sum += value * weight;
+	s->total += weight;
+
+	/* Values are piecewise constant, so the same value is often added repeatedly */
+	pos = 0;
+	while (pos < s->n && s->mean[pos] < value) {
+		pos++;
+	}
+	if (pos < s->n && s->mean[pos] == value) {
+		s->weight[pos] += weight;
+		return;
+	}
+
+	for (i = s->n; i > pos; i--) {
+		s->mean[i] = s->mean[i - 1];
+		s->weight[i] = s->weight[i - 1];
+	}
+	s->mean[pos] = value;
+	s->weight[pos] = weight;
+	s->n++;
+
+	if (s->n <= PQSTATS_SKETCH_SIZE) {
+		return;
+	}
+
+	/* Merge the two closest centroids */
+	merge = 0;
+	minGap = s->mean[1] - s->mean[0];
+	for (i = 1; i < s->n - 1; i++) {
+		gap = s->mean[i + 1] - s->mean[i];
+		if (gap < minGap) {
+			minGap = gap;
+			merge = i;
+		}
+	}
+
+	weight = s->weight[merge] + s->weight[merge + 1];
+	s->mean[merge] = (s->mean[merge] * s->weight[merge] + s->mean[merge + 1] * s->weight[merge + 1]) / weight;
+	s->weight[merge] = weight;
+	s->n--;
+	for (i = merge + 1; i < s->n; i++) {
+		s->mean[i] = s->mean[i + 1];
+		s->weight[i] = s->weight[i + 1];
+	}
+}
+
+
+static double sketch_quantile(const pqstats_sketch_t *s, double q)
+{
+	double target = q * s->total;
+	double cumulative = 0;
+
+	for (int i = 0; i < s->n; i++) {
+		cumulative += s->weight[i];
+		if (cumulative >= target) {
+			return s->mean[i];
+		}
+	}
+
+	return s->max;
+}
+
+
+static void sketch_get(const pqstats_sketch_t *s, metersim_pqAggregate_t *ret)
+{
+	if (s->total == 0) {
+		*ret = (metersim_pqAggregate_t) { 0 };
+		return;
+	}
+
+	ret->min = s->min;
+	ret->max = s->max;
+	ret->mean = s->sum / s->total;
+	ret->p95 = sketch_quantile(s, 0.95);
+}
+
+
+void pqstats_init(pqstats_ctx_t *ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+
+	for (int i = 0; i < METERSIM_PQ_WINDOW_COUNT; i++) {
+		ctx->window[i].length = windowLengths[i];
+		ctx->window[i].nextEnd = windowLengths[i];
+	}
+}
+
+
+void pqstats_accumulate(pqstats_ctx_t *ctx, const metersim_state_t *state, int32_t dt)
+{
+	const double w = (double)dt;
+	pqstats_window_t *win;
+
+	if (dt == 0) {
+		return;
+	}
+
+	for (int i = 0; i < METERSIM_PQ_WINDOW_COUNT; i++) {
+		win = &ctx->window[i];
+		for (int j = 0; j < state->cfg.phaseCount; j++) {
+			sketch_add(&win->sketch[j], state->instant.voltage[j], w);
+			sketch_add(&win->sketch[4 + j], state->thd.thdU[j], w);
+			sketch_add(&win->sketch[7 + j], state->thd.thdI[j], w);
+		}
+		sketch_add(&win->sketch[3], state->instant.frequency, w);
+	}
+}
+
+
+int32_t pqstats_getNextBoundary(pqstats_ctx_t *ctx)
+{
+	int32_t res = METERSIM_NO_UPDATE_SCHEDULED;
+
+	for (int i = 0; i < METERSIM_PQ_WINDOW_COUNT; i++) {
+		if (ctx->window[i].nextEnd < res) {
+			res = ctx->window[i].nextEnd;
+		}
+	}
+
+	return res;
+}
+
+
+void pqstats_close(pqstats_ctx_t *ctx, uint8_t phaseCount, int32_t now)
+{
+	pqstats_window_t *win;
+	metersim_pqStats_t *last;
+
+	for (int i = 0; i < METERSIM_PQ_WINDOW_COUNT; i++) {
+		win = &ctx->window[i];
+		if (win->nextEnd != now) {
+			continue;
+		}
+
+		last = &win->last;
+		*last = (metersim_pqStats_t) { 0 };
+		last->start = win->start;
+		last->end = now;
+		for (int j = 0; j < phaseCount; j++) {
+			sketch_get(&win->sketch[j], &last->voltage[j]);
+			sketch_get(&win->sketch[4 + j], &last->thdU[j]);
+			sketch_get(&win->sketch[7 + j], &last->thdI[j]);
+		}
+		sketch_get(&win->sketch[3], &last->frequency);
+
+		for (int j = 0; j < PQSTATS_QUANTITIES; j++) {
+			sketch_reset(&win->sketch[j]);
+		}
+		win->start = now;
+		win->nextEnd = now <= METERSIM_NO_UPDATE_SCHEDULED - win->length ? now + win->length : METERSIM_NO_UPDATE_SCHEDULED;
+	}
+}
+
+
+void pqstats_get(pqstats_ctx_t *ctx, metersim_pqStats_t *ret, int window)
+{
+	assert(window >= 0 && window < METERSIM_PQ_WINDOW_COUNT);
+
+	*ret = ctx->window[window].last;
+}
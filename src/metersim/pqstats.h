@@ -0,0 +1,69 @@
+/*
+ * Power quality aggregation of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef PQSTATS_H
+#define PQSTATS_H
+
+#include <stdint.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+
+/* Number of centroids kept by a quantile sketch */
+#define PQSTATS_SKETCH_SIZE 32
+
+/* Aggregated quantities: voltage[3], frequency, thdU[3], thdI[3] */
+#define PQSTATS_QUANTITIES 10
+
+
+/* Time-weighted quantile sketch with a constant number of centroids */
+typedef struct {
+	uint8_t n;
+	double mean[PQSTATS_SKETCH_SIZE + 1];
+	double weight[PQSTATS_SKETCH_SIZE + 1];
+
+	double min;
+	double max;
+	double sum;   /* integral of the value over time */
+	double total; /* (s) sum of the weights */
+} pqstats_sketch_t;
+
+
+typedef struct {
+	int32_t length; /* (s) */
+	int32_t start;
+	int32_t nextEnd;
+	pqstats_sketch_t sketch[PQSTATS_QUANTITIES];
+	metersim_pqStats_t last;
+} pqstats_window_t;
+
+
+typedef struct {
+	pqstats_window_t window[METERSIM_PQ_WINDOW_COUNT];
+} pqstats_ctx_t;
+
+
+void pqstats_init(pqstats_ctx_t *ctx);
+
+
+/* Adds a segment with constant state. The segment must not cross the end of a window. */
+void pqstats_accumulate(pqstats_ctx_t *ctx, const metersim_state_t *state, int32_t dt);
+
+
+/* Returns uptime at which the first of the current windows ends */
+int32_t pqstats_getNextBoundary(pqstats_ctx_t *ctx);
+
+
+/* Closes windows ending at `now` */
+void pqstats_close(pqstats_ctx_t *ctx, uint8_t phaseCount, int32_t now);
+
+
+void pqstats_get(pqstats_ctx_t *ctx, metersim_pqStats_t *ret, int window);
+
+#endif /* PQSTATS_H */
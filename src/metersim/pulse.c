@@ -0,0 +1,139 @@
+/*
+ * Metrological pulse output of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "pulse.h"
+#include "ring.h"
+#include "log.h"
+
+#define LOG_TAG "pulse : "
+
+
+int pulse_init(pulse_ctx_t *ctx, const metersim_config_t *cfg)
+{
+	memset(ctx, 0, sizeof(*ctx));
+
+	if (cfg->pulseBufferSize == 0 || cfg->meterConstant == 0) {
+		return 0;
+	}
+
+	if (ring_init(&ctx->log, sizeof(metersim_pulse_t), cfg->pulseBufferSize) < 0) {
+		log_error("Could not allocate memory for pulse output");
+		return -1;
+	}
+
+	ctx->constant = (double)cfg->meterConstant;
+	ctx->enabled = true;
+
+	return 0;
+}
+
+
+void pulse_reset(pulse_ctx_t *ctx)
+{
+	memset(ctx->residual, 0, sizeof(ctx->residual));
+	if (ctx->enabled) {
+		ring_clear(&ctx->log);
+	}
+}
+
+
+void pulse_destroy(pulse_ctx_t *ctx)
+{
+	if (ctx->enabled) {
+		ring_destroy(&ctx->log);
+	}
+}
+
+
+void pulse_accumulate(pulse_ctx_t *ctx, const metersim_state_t *state, int32_t start, int32_t dt)
+{
+	double power[METERSIM_PULSE_CHANNELS] = { 0 };
+	uint64_t count[METERSIM_PULSE_CHANNELS], k[METERSIM_PULSE_CHANNELS];
+	double before[METERSIM_PULSE_CHANNELS], next[METERSIM_PULSE_CHANNELS];
+	double energy;
+	uint64_t remaining = 0;
+	metersim_pulse_t pulse;
+	int c, first;
+
+	if (!ctx->enabled || dt == 0) {
+		return;
+	}
+
+	for (int i = 0; i < state->cfg.phaseCount; i++) {
+		if (state->power.truePower[i] > 0) {
+			power[METERSIM_PULSE_ACTIVE_PLUS] += state->power.truePower[i];
+		}
+		else {
+			power[METERSIM_PULSE_ACTIVE_MINUS] -= state->power.truePower[i];
+		}
+
+		if (state->power.reactivePower[i] > 0) {
+			power[METERSIM_PULSE_REACTIVE_PLUS] += state->power.reactivePower[i];
+		}
+		else {
+			power[METERSIM_PULSE_REACTIVE_MINUS] -= state->power.reactivePower[i];
+		}
+	}
+
+	/*
+	 * The k-th pulse of the segment is emitted when the residual plus p * t reaches k * constant,
+	 * so its time is computed directly instead of ticking through the segment.
+	 */
+	for (c = 0; c < METERSIM_PULSE_CHANNELS; c++) {
+		before[c] = ctx->residual[c];
+		energy = before[c] + power[c] * dt;
+		count[c] = (uint64_t)floor(energy / ctx->constant);
+		ctx->residual[c] = energy - (double)count[c] * ctx->constant;
+		remaining += count[c];
+		k[c] = 1;
+		next[c] = count[c] > 0 ? (ctx->constant - before[c]) / power[c] : 0;
+	}
+
+	/* Merge the channels in the order of time */
+	while (remaining > 0 && !ring_isFull(&ctx->log)) {
+		first = -1;
+		for (c = 0; c < METERSIM_PULSE_CHANNELS; c++) {
+			if (k[c] <= count[c] && (first < 0 || next[c] < next[first])) {
+				first = c;
+			}
+		}
+
+		pulse.channel = (uint8_t)first;
+		pulse.timestamp = start + next[first];
+		ring_push(&ctx->log, &pulse);
+
+		k[first]++;
+		next[first] = ((double)k[first] * ctx->constant - before[first]) / power[first];
+		remaining--;
+	}
+
+	if (remaining > 0) {
+		if (__atomic_load_n(&ctx->log.dropped, __ATOMIC_RELAXED) == 0) {
+			log_warning("Pulse output buffer is full, pulses are dropped");
+		}
+		ring_drop(&ctx->log, (uint32_t)(remaining > UINT32_MAX ? UINT32_MAX : remaining));
+	}
+}
+
+
+size_t pulse_read(pulse_ctx_t *ctx, metersim_pulse_t *buf, size_t n)
+{
+	if (!ctx->enabled) {
+		return 0;
+	}
+
+	return ring_pop(&ctx->log, buf, n);
+}
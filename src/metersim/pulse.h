@@ -0,0 +1,49 @@
+/*
+ * Metrological pulse output of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef PULSE_H
+#define PULSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "ring.h"
+
+
+typedef struct {
+	bool enabled;
+	double constant; /* (Ws) or (vars) per pulse */
+
+	double residual[METERSIM_PULSE_CHANNELS]; /* energy accumulated since the last pulse */
+
+	ring_t log;
+} pulse_ctx_t;
+
+
+int pulse_init(pulse_ctx_t *ctx, const metersim_config_t *cfg);
+
+
+/* Drops buffered pulses and partial energy, keeps the allocated buffer */
+void pulse_reset(pulse_ctx_t *ctx);
+
+
+void pulse_destroy(pulse_ctx_t *ctx);
+
+
+/* Emits pulses of a segment [start, start + dt] with constant power. Called by the single producer. */
+void pulse_accumulate(pulse_ctx_t *ctx, const metersim_state_t *state, int32_t start, int32_t dt);
+
+
+/* Pops emitted pulses. Can be called concurrently with pulse_accumulate. */
+size_t pulse_read(pulse_ctx_t *ctx, metersim_pulse_t *buf, size_t n);
+
+#endif /* PULSE_H */
@@ -0,0 +1,93 @@
+/*
+ * Readings published for lock-free getters
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "calculator.h"
+#include "readings.h"
+
+
+/* Hint to the CPU that the reader is retrying, e.g. to yield to the other hardware thread of the core */
+static inline void cpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ volatile("yield");
+#endif
+}
+
+
+void readings_init(readings_ctx_t *ctx)
+{
+	ctx->index = 0;
+	for (int i = 0; i < 2; i++) {
+		ctx->slot[i].seq = 0;
+		ctx->slot[i].buf = (readings_buf_t) { 0 };
+	}
+}
+
+
+void readings_publish(readings_ctx_t *ctx, const metersim_state_t *state, int32_t now)
+{
+	readings_buf_t buf = { 0 };
+	uint32_t index = __atomic_load_n(&ctx->index, __ATOMIC_RELAXED) ^ 1;
+	readings_slot_t *slot = &ctx->slot[index];
+	uint32_t seq = slot->seq;
+
+	buf.data.now = now;
+	buf.data.currentTariff = state->currentTariff;
+	buf.data.instant = state->instant;
+	buf.data.power = state->power;
+	buf.data.vector = state->vector;
+	buf.data.thd = state->thd;
+	calculator_getEnergyTotal(state, &buf.data.energyTotal);
+
+	__atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for (size_t i = 0; i < sizeof(buf.words) / sizeof(buf.words[0]); i++) {
+		__atomic_store_n(&slot->buf.words[i], buf.words[i], __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&ctx->index, index, __ATOMIC_RELEASE);
+}
+
+
+void readings_read(const readings_ctx_t *ctx, size_t offset, size_t size, void *ret)
+{
+	const size_t first = offset / sizeof(uint64_t);
+	const size_t last = (offset + size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+	const readings_slot_t *slot;
+	readings_buf_t buf;
+	uint32_t seq;
+
+	for (;;) {
+		slot = &ctx->slot[__atomic_load_n(&ctx->index, __ATOMIC_ACQUIRE)];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+		/* Only the words covering the requested field are copied */
+		for (size_t i = first; i < last; i++) {
+			buf.words[i] = __atomic_load_n(&slot->buf.words[i], __ATOMIC_RELAXED);
+		}
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if ((seq & 1) == 0 && __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+			memcpy(ret, (const uint8_t *)&buf.data + offset, size);
+			return;
+		}
+
+		cpuRelax();
+	}
+}
@@ -0,0 +1,68 @@
+/*
+ * Readings published for lock-free getters
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef READINGS_H
+#define READINGS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+
+
+typedef struct {
+	int32_t now;
+	uint8_t currentTariff;
+	metersim_instant_t instant;
+	metersim_power_t power;
+	metersim_vector_t vector;
+	metersim_thd_t thd;
+	metersim_energy_t energyTotal;
+} readings_data_t;
+
+
+/* Readings as words, copied with atomic accesses so that a torn copy is detected rather than a data race */
+typedef union {
+	readings_data_t data;
+	uint64_t words[(sizeof(readings_data_t) + sizeof(uint64_t) - 1) / sizeof(uint64_t)];
+} readings_buf_t;
+
+
+typedef struct {
+	uint32_t seq; /* odd while the slot is being written */
+	readings_buf_t buf;
+} readings_slot_t;
+
+
+/*
+ * Double buffer of the derived state. The single writer never waits for readers, it fills the slot which is
+ * not the newest one and then switches to it. Readers never wait for a publish in progress; they are lock-free,
+ * retrying only if the writer published twice during their copy and reused its slot.
+ */
+typedef struct {
+	uint32_t index; /* slot with the newest readings */
+	readings_slot_t slot[2];
+} readings_ctx_t;
+
+
+void readings_init(readings_ctx_t *ctx);
+
+
+/* Writer side. Calls must be serialized by the caller. */
+void readings_publish(readings_ctx_t *ctx, const metersim_state_t *state, int32_t now);
+
+
+/* Reader side. Copies `size` bytes at `offset` of the published readings_data_t to `ret`. */
+void readings_read(const readings_ctx_t *ctx, size_t offset, size_t size, void *ret);
+
+
+#define readings_get(ctx, field, ret) readings_read((ctx), offsetof(readings_data_t, field), sizeof(*(ret)), (ret))
+
+#endif /* READINGS_H */
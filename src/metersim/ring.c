@@ -0,0 +1,116 @@
+/*
+ * Lock-free single-producer ring buffer
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "ring.h"
+
+
+int ring_init(ring_t *ring, size_t elemSize, uint32_t capacity)
+{
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+		return -1;
+	}
+
+	ring->data = malloc(elemSize * capacity);
+	if (ring->data == NULL) {
+		return -1;
+	}
+
+	ring->elemSize = elemSize;
+	ring->capacity = capacity;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->dropped = 0;
+
+	return 0;
+}
+
+
+void ring_destroy(ring_t *ring)
+{
+	free(ring->data);
+	ring->data = NULL;
+}
+
+
+bool ring_push(ring_t *ring, const void *elem)
+{
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail >= ring->capacity) {
+		__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	memcpy(ring->data + (size_t)(head & (ring->capacity - 1)) * ring->elemSize, elem, ring->elemSize);
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+
+void ring_drop(ring_t *ring, uint32_t count)
+{
+	__atomic_fetch_add(&ring->dropped, count, __ATOMIC_RELAXED);
+}
+
+
+bool ring_isFull(ring_t *ring)
+{
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	return head - tail >= ring->capacity;
+}
+
+
+size_t ring_pop(ring_t *ring, void *buf, size_t n)
+{
+	uint32_t head, tail, count, first, idx;
+	uint8_t *dst = buf;
+
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	for (;;) {
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		count = head - tail;
+		if (count > ring->capacity) {
+			/* Our tail is stale, the CAS below fails */
+			count = ring->capacity;
+		}
+		if (count > n) {
+			count = (uint32_t)n;
+		}
+		if (count == 0) {
+			return 0;
+		}
+
+		/* Copy (possibly wrapping) elements, then claim them. If another consumer has claimed them in the meantime, the copy might be stale and is repeated. */
+		idx = tail & (ring->capacity - 1);
+		first = ring->capacity - idx < count ? ring->capacity - idx : count;
+		memcpy(dst, ring->data + (size_t)idx * ring->elemSize, (size_t)first * ring->elemSize);
+		memcpy(dst + (size_t)first * ring->elemSize, ring->data, (size_t)(count - first) * ring->elemSize);
+
+		if (__atomic_compare_exchange_n(&ring->tail, &tail, tail + count, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			return count;
+		}
+	}
+}
+
+
+void ring_clear(ring_t *ring)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->dropped = 0;
+}
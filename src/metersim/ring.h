@@ -0,0 +1,57 @@
+/*
+ * Lock-free single-producer ring buffer
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+
+/*
+ * Elements are pushed by a single producer and popped by any number of consumers
+ * without taking locks. When the ring is full, new elements are dropped.
+ */
+typedef struct {
+	uint8_t *data;
+	size_t elemSize;
+	uint32_t capacity; /* power of two */
+	uint32_t head;     /* written only by the producer */
+	uint32_t tail;     /* advanced by consumers */
+	uint32_t dropped;
+} ring_t;
+
+
+int ring_init(ring_t *ring, size_t elemSize, uint32_t capacity);
+
+
+void ring_destroy(ring_t *ring);
+
+
+/* Producer side. Returns false if the element was dropped. */
+bool ring_push(ring_t *ring, const void *elem);
+
+
+/* Producer side. Accounts `count` elements which were dropped without being pushed. */
+void ring_drop(ring_t *ring, uint32_t count);
+
+
+/* Returns true if the ring has no free space */
+bool ring_isFull(ring_t *ring);
+
+
+/* Consumer side. Pops at most `n` elements to `buf` and returns their number. */
+size_t ring_pop(ring_t *ring, void *buf, size_t n);
+
+
+/* Removes all elements. Must not be called concurrently with other operations. */
+void ring_clear(ring_t *ring);
+
+#endif /* RING_H */
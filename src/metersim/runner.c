@@ -7,33 +7,87 @@
  * %LICENSE%
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* CPU affinity of threads */
+#endif
+
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <errno.h>
 #include <time.h>
 #include <assert.h>
+#include <sys/mman.h>
 
 #include <metersim/metersim_types.h>
 #include "metersim_types_int.h"
 #include "time_machine.h"
+#include "clocksrc.h"
 #include "simulator.h"
 #include "runner.h"
+#include "runner_group.h"
 #include "log.h"
 
 #define RUNNER_STACKSIZE 1024
 #define LOG_TAG          "runner : "
 
 
+/* Memory of the process stays locked once a runner thread has started with it locked */
+static pthread_mutex_t memoryLock = PTHREAD_MUTEX_INITIALIZER;
+static bool memoryLocked = false;
+
+
 static inline int32_t min(int32_t a, int32_t b)
 {
 	return a < b ? a : b;
 }
 
 
+static inline bool hasTimeMachine(runner_ctx_t *rctx)
+{
+	return rctx->type == runner_typeTimeMachine || rctx->type == runner_typeLazy;
+}
+
+
+/* Steps the simulator of a lazy runner to the time of its clock. Must be called with rctx->lock held. */
+static void catchUp(runner_ctx_t *rctx)
+{
+	simulator_ctx_t *sctx = rctx->sctx;
+	int32_t now;
+
+	if (!rctx->running) {
+		return;
+	}
+
+	now = timeMachine_gettime(&rctx->tmCtx);
+	if (simulator_stepForwardWatched(sctx, now - sctx->now)) {
+		now = sctx->now;
+		timeMachine_stopAt(&rctx->tmCtx, now);
+		rctx->stopTime = now;
+	}
+
+	if (now == rctx->stopTime) {
+		rctx->running = false;
+	}
+}
+
+
 void runner_update(runner_ctx_t *rctx)
 {
+	if (rctx->type == runner_typeGroup) {
+		/* Takes the lock of the group before the one of the runner, like the group thread */
+		runnerGroup_update(rctx->group, rctx);
+		return;
+	}
+
 	pthread_mutex_lock(&rctx->lock);
-	if (rctx->running) {
+	if (rctx->type == runner_typeLazy) {
+		catchUp(rctx);
+	}
+	else if (rctx->type == runner_typePushed) {
+		/* The simulator is always at the last pushed time */
+	}
+	else if (rctx->running) {
 		rctx->updating = true;
 		pthread_cond_broadcast(&rctx->cond);
 		while (rctx->updating) {
@@ -46,7 +100,7 @@ void runner_update(runner_ctx_t *rctx)
 
 void runner_setSpeedup(runner_ctx_t *rctx, uint16_t speedup)
 {
-	if (rctx->type != runner_typeTimeMachine) {
+	if (!hasTimeMachine(rctx)) {
 		return;
 	}
 
@@ -56,6 +110,26 @@ void runner_setSpeedup(runner_ctx_t *rctx, uint16_t speedup)
 }
 
 
+uint16_t runner_getSpeedup(runner_ctx_t *rctx)
+{
+	uint16_t speedup;
+
+	if (rctx->type == runner_typeGroup) {
+		return runnerGroup_getSpeedup(rctx->group);
+	}
+
+	if (!hasTimeMachine(rctx)) {
+		return 1;
+	}
+
+	pthread_mutex_lock(&rctx->lock);
+	speedup = (uint16_t)rctx->tmCtx.speedup;
+	pthread_mutex_unlock(&rctx->lock);
+
+	return speedup;
+}
+
+
 static void _pauseAndWait(runner_ctx_t *rctx)
 {
 	log_debug("Pausing");
@@ -72,14 +146,14 @@ static void _pauseAndWait(runner_ctx_t *rctx)
 static void _sleepOnCond(runner_ctx_t *rctx, int16_t sleepMilisec)
 {
 	struct timespec ts;
-	clock_gettime(CLOCK_MONOTONIC, &ts);
+	clocksrc_gettime(rctx->opts.clock, &ts);
 	ts.tv_nsec += (long)(sleepMilisec % 1000) * 1000 * 1000;
 	if (ts.tv_nsec >= 1000 * 1000 * 1000) {
 		ts.tv_nsec -= 1000 * 1000 * 1000;
 		ts.tv_sec++;
 	}
 	ts.tv_sec += sleepMilisec / 1000;
-	pthread_cond_timedwait(&rctx->cond, &rctx->lock, &ts);
+	clocksrc_timedwait(rctx->opts.clock, &rctx->cond, &rctx->lock, &ts);
 }
 
 
@@ -123,6 +197,8 @@ static void *runnerTimeMachineThread(void *arg)
 {
 	int32_t now = 0;
 	int32_t nextWakeupTime = 0;
+	bool timedOut = false;
+	struct timespec ts, woken;
 	runner_ctx_t *rctx = (runner_ctx_t *)arg;
 	simulator_ctx_t *sctx = rctx->sctx;
 
@@ -133,7 +209,18 @@ static void *runnerTimeMachineThread(void *arg)
 	log_debug("Starting time machine runner");
 	for (;;) {
 		now = timeMachine_gettime(&rctx->tmCtx);
-		simulator_stepForward(sctx, now - sctx->now);
+		if (simulator_stepForwardWatched(sctx, now - sctx->now)) {
+			/* Pausing watchpoint triggered before `now`, the clock goes back to it */
+			now = sctx->now;
+			timeMachine_stopAt(&rctx->tmCtx, now);
+			rctx->stopTime = now;
+		}
+
+		if (timedOut) {
+			clocksrc_gettime(rctx->opts.clock, &woken);
+			latency_record(&rctx->latency[METERSIM_LATENCY_STEP], latency_elapsed(&ts, &woken));
+			timedOut = false;
+		}
 
 		if (rctx->shutdownFlag) {
 			break;
@@ -156,9 +243,12 @@ static void *runnerTimeMachineThread(void *arg)
 				pthread_cond_wait(&rctx->cond, &rctx->lock);
 			}
 			else {
-				struct timespec ts = { 0 };
 				timeMachine_getWaitTime(&rctx->tmCtx, nextWakeupTime, &ts);
-				pthread_cond_timedwait(&rctx->cond, &rctx->lock, &ts);
+				if (clocksrc_timedwait(rctx->opts.clock, &rctx->cond, &rctx->lock, &ts) == ETIMEDOUT) {
+					clocksrc_gettime(rctx->opts.clock, &woken);
+					latency_record(&rctx->latency[METERSIM_LATENCY_WAKEUP], latency_elapsed(&ts, &woken));
+					timedOut = true;
+				}
 			}
 		}
 	}
@@ -172,7 +262,7 @@ static void *runnerTimeMachineThread(void *arg)
 
 void runner_resume(runner_ctx_t *rctx)
 {
-	if (rctx->type != runner_typeTimeMachine) {
+	if (!hasTimeMachine(rctx)) {
 		return;
 	}
 
@@ -190,7 +280,7 @@ void runner_resume(runner_ctx_t *rctx)
 
 void runner_pause(runner_ctx_t *rctx, int32_t when)
 {
-	if (rctx->type != runner_typeTimeMachine) {
+	if (!hasTimeMachine(rctx)) {
 		return;
 	}
 
@@ -205,12 +295,21 @@ bool runner_isRunning(runner_ctx_t *rctx)
 {
 	bool ret;
 	pthread_mutex_lock(&rctx->lock);
+	if (rctx->type == runner_typeLazy) {
+		catchUp(rctx);
+	}
 	ret = rctx->running;
 	pthread_mutex_unlock(&rctx->lock);
 	return ret;
 }
 
 
+bool runner_isDriven(runner_ctx_t *rctx)
+{
+	return rctx->type == runner_typeGroup || rctx->type == runner_typePushed;
+}
+
+
 int32_t runner_getTime(runner_ctx_t *rctx)
 {
 	int32_t ret;
@@ -227,6 +326,8 @@ int64_t runner_getTimeUtc(runner_ctx_t *rctx)
 	pthread_mutex_lock(&rctx->lock);
 	switch (rctx->type) {
 		case runner_typeTimeMachine:
+		case runner_typeLazy:
+		case runner_typeGroup:
 			ret = rctx->sctx->state.cfg.startTime + rctx->sctx->now;
 			break;
 
@@ -234,6 +335,10 @@ int64_t runner_getTimeUtc(runner_ctx_t *rctx)
 			ret = (int64_t)rctx->getTimeCb(rctx->cbArgs);
 			break;
 
+		case runner_typePushed:
+			ret = rctx->startUtc + rctx->sctx->now;
+			break;
+
 		default:
 			return -1;
 	}
@@ -242,6 +347,28 @@ int64_t runner_getTimeUtc(runner_ctx_t *rctx)
 }
 
 
+int64_t runner_getStartUtc(runner_ctx_t *rctx)
+{
+	int64_t ret;
+	pthread_mutex_lock(&rctx->lock);
+	switch (rctx->type) {
+		case runner_typeCustomGetTime:
+			ret = (int64_t)rctx->getTimeCb(rctx->cbArgs) - rctx->sctx->now;
+			break;
+
+		case runner_typePushed:
+			ret = rctx->startUtc;
+			break;
+
+		default:
+			ret = rctx->sctx->state.cfg.startTime;
+			break;
+	}
+	pthread_mutex_unlock(&rctx->lock);
+	return ret;
+}
+
+
 void runner_setTimeUtc(runner_ctx_t *rctx, int64_t time)
 {
 	pthread_mutex_lock(&rctx->lock);
@@ -250,9 +377,113 @@ void runner_setTimeUtc(runner_ctx_t *rctx, int64_t time)
 }
 
 
-int runner_start(runner_ctx_t *rctx)
+void runner_getLatency(runner_ctx_t *rctx, int kind, metersim_latency_t *ret)
+{
+	pthread_mutex_lock(&rctx->lock);
+	*ret = rctx->latency[kind];
+	pthread_mutex_unlock(&rctx->lock);
+}
+
+
+int runner_setOpts(runner_ctx_t *rctx, const metersim_runnerOpts_t *opts)
+{
+	int policy;
+
+	if (opts->cpu < -1 || opts->cpu >= CPU_SETSIZE) {
+		return -1;
+	}
+
+	switch (opts->policy) {
+		case METERSIM_SCHED_DEFAULT:
+			break;
+
+		case METERSIM_SCHED_FIFO:
+		case METERSIM_SCHED_RR:
+			policy = opts->policy == METERSIM_SCHED_FIFO ? SCHED_FIFO : SCHED_RR;
+			if (opts->priority < sched_get_priority_min(policy) || opts->priority > sched_get_priority_max(policy)) {
+				return -1;
+			}
+			break;
+
+		default:
+			return -1;
+	}
+
+	rctx->opts = *opts;
+	if (hasTimeMachine(rctx)) {
+		timeMachine_init(&rctx->tmCtx, rctx->tmCtx.speedup, opts->clock);
+	}
+
+	return 0;
+}
+
+
+/* Locks the memory of the process if it is not locked yet. Returns 1 if it was locked by this call, 0 if it was already, -1 on error. */
+static int lockMemory(void)
 {
 	int ret = 0;
+
+	pthread_mutex_lock(&memoryLock);
+	if (!memoryLocked) {
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+			log_error("Could not lock memory (errno %d)", errno);
+			ret = -1;
+		}
+		else {
+			memoryLocked = true;
+			ret = 1;
+		}
+	}
+	pthread_mutex_unlock(&memoryLock);
+
+	return ret;
+}
+
+
+/* Undoes lockMemory of a runner which failed to start */
+static void unlockMemory(int locked)
+{
+	if (locked <= 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&memoryLock);
+	munlockall();
+	memoryLocked = false;
+	pthread_mutex_unlock(&memoryLock);
+}
+
+
+static int applyOpts(runner_ctx_t *rctx, pthread_attr_t *attr)
+{
+	const metersim_runnerOpts_t *opts = &rctx->opts;
+	struct sched_param param = { 0 };
+	cpu_set_t cpus;
+
+	if (opts->cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(opts->cpu, &cpus);
+		if (pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus) != 0) {
+			return -1;
+		}
+	}
+
+	if (opts->policy != METERSIM_SCHED_DEFAULT) {
+		param.sched_priority = opts->priority;
+		if (pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED) != 0 ||
+				pthread_attr_setschedpolicy(attr, opts->policy == METERSIM_SCHED_FIFO ? SCHED_FIFO : SCHED_RR) != 0 ||
+				pthread_attr_setschedparam(attr, &param) != 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+int runner_start(runner_ctx_t *rctx)
+{
+	int ret = 0, locked = 0;
 	pthread_attr_t attr;
 	ret = pthread_attr_init(&attr);
 	if (ret < 0) {
@@ -265,8 +496,34 @@ int runner_start(runner_ctx_t *rctx)
 		return ret;
 	}
 
-	if (rctx->type == runner_typeTimeMachine && rctx->stopTime != 0) {
-		timeMachine_start(&rctx->tmCtx, rctx->sctx->now);
+	if (hasTimeMachine(rctx)) {
+		if (rctx->stopTime != 0) {
+			timeMachine_start(&rctx->tmCtx, rctx->sctx->now);
+		}
+		else {
+			/* Paused immediately, the clock must not be behind the simulator which might have been stepped already */
+			timeMachine_stopAt(&rctx->tmCtx, rctx->sctx->now);
+			rctx->stopTime = rctx->sctx->now;
+		}
+	}
+
+	if (rctx->type == runner_typeGroup) {
+		pthread_attr_destroy(&attr);
+		if (runnerGroup_add(rctx->group, rctx) < 0) {
+			return -1;
+		}
+		pthread_mutex_lock(&rctx->lock);
+		rctx->running = true;
+		pthread_mutex_unlock(&rctx->lock);
+		return 0;
+	}
+
+	if (rctx->type == runner_typeLazy || rctx->type == runner_typePushed) {
+		pthread_attr_destroy(&attr);
+		pthread_mutex_lock(&rctx->lock);
+		rctx->running = rctx->type == runner_typePushed || rctx->stopTime != rctx->sctx->now;
+		pthread_mutex_unlock(&rctx->lock);
+		return 0;
 	}
 
 	void *mainThread = NULL;
@@ -284,15 +541,59 @@ int runner_start(runner_ctx_t *rctx)
 			return -1;
 	}
 
+	if (rctx->opts.lockMemory) {
+		locked = lockMemory();
+		if (locked < 0) {
+			pthread_attr_destroy(&attr);
+			return -1;
+		}
+	}
+
+	if (applyOpts(rctx, &attr) < 0) {
+		pthread_attr_destroy(&attr);
+		unlockMemory(locked);
+		return -1;
+	}
+
+	if (clocksrc_register(rctx->opts.clock, &rctx->lock, &rctx->cond) < 0) {
+		pthread_attr_destroy(&attr);
+		unlockMemory(locked);
+		return -1;
+	}
+
+	/* Accesses wait for the first step of the thread, which might start only after a manual clock has moved */
+	rctx->running = true;
+
+	/* Fails with EPERM if a real-time policy is not permitted */
 	ret = pthread_create(&rctx->runnerThread, &attr, mainThread, rctx);
 	pthread_attr_destroy(&attr);
+	if (ret != 0) {
+		log_error("Could not create the runner thread (error %d)", ret);
+		clocksrc_unregister(rctx->opts.clock, &rctx->cond);
+		unlockMemory(locked);
+		rctx->running = false;
+		return -1;
+	}
 
-	return ret;
+	return 0;
 }
 
 
 void runner_finish(runner_ctx_t *rctx)
 {
+	if (rctx->type == runner_typeGroup) {
+		runner_update(rctx);
+		runnerGroup_remove(rctx->group, rctx);
+		rctx->running = false;
+		return;
+	}
+
+	if (rctx->type == runner_typeLazy || rctx->type == runner_typePushed) {
+		runner_update(rctx);
+		rctx->running = false;
+		return;
+	}
+
 	pthread_mutex_lock(&rctx->lock);
 	rctx->shutdownFlag = true;
 	rctx->updating = true;
@@ -301,6 +602,7 @@ void runner_finish(runner_ctx_t *rctx)
 
 	pthread_cond_broadcast(&rctx->cond);
 	pthread_join(rctx->runnerThread, NULL);
+	clocksrc_unregister(rctx->opts.clock, &rctx->cond);
 	rctx->updating = false;
 	rctx->running = false;
 }
@@ -323,6 +625,11 @@ runner_ctx_t *runner_init(simulator_ctx_t *sctx, uint64_t (*getTimeCb)(void *),
 	rctx->shutdownFlag = false;
 	rctx->updating = false;
 	rctx->stopTime = METERSIM_NO_UPDATE_SCHEDULED;
+	rctx->opts.cpu = -1;
+	rctx->opts.policy = METERSIM_SCHED_DEFAULT;
+	for (int i = 0; i < METERSIM_LATENCY_KINDS; i++) {
+		latency_init(&rctx->latency[i]);
+	}
 
 	status = pthread_mutex_init(&rctx->lock, NULL);
 	if (status < 0) {
@@ -355,7 +662,32 @@ runner_ctx_t *runner_init(simulator_ctx_t *sctx, uint64_t (*getTimeCb)(void *),
 	}
 
 	if (rctx->type == runner_typeTimeMachine) {
-		timeMachine_init(&rctx->tmCtx, rctx->sctx->state.cfg.speedup);
+		timeMachine_init(&rctx->tmCtx, rctx->sctx->state.cfg.speedup, NULL);
+	}
+
+	return rctx;
+}
+
+
+runner_ctx_t *runner_initLazy(simulator_ctx_t *sctx, struct metersim_clock_s *clock)
+{
+	runner_ctx_t *rctx = runner_init(sctx, NULL, NULL);
+	if (rctx != NULL) {
+		rctx->type = runner_typeLazy;
+		rctx->opts.clock = clock;
+		timeMachine_init(&rctx->tmCtx, rctx->tmCtx.speedup, clock);
+	}
+
+	return rctx;
+}
+
+
+runner_ctx_t *runner_initGroup(simulator_ctx_t *sctx, struct metersim_group_s *group)
+{
+	runner_ctx_t *rctx = runner_init(sctx, NULL, NULL);
+	if (rctx != NULL) {
+		rctx->type = runner_typeGroup;
+		rctx->group = group;
 	}
 
 	return rctx;
@@ -368,3 +700,40 @@ void runner_destroy(runner_ctx_t *rctx)
 	pthread_cond_destroy(&rctx->cond);
 	free(rctx);
 }
+
+
+runner_ctx_t *runner_initPushed(simulator_ctx_t *sctx, int64_t nowUtc)
+{
+	runner_ctx_t *rctx = runner_init(sctx, NULL, NULL);
+	if (rctx != NULL) {
+		rctx->type = runner_typePushed;
+		rctx->startUtc = nowUtc - sctx->now;
+	}
+
+	return rctx;
+}
+
+
+int runner_advanceTime(runner_ctx_t *rctx, int64_t utc, int64_t *nextUtc)
+{
+	simulator_ctx_t *sctx = rctx->sctx;
+	int32_t next;
+
+	if (rctx->type != runner_typePushed) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&rctx->lock);
+	if (utc < rctx->startUtc + sctx->now || utc - rctx->startUtc > INT32_MAX) {
+		pthread_mutex_unlock(&rctx->lock);
+		return -1;
+	}
+
+	simulator_stepForward(sctx, (int32_t)(utc - rctx->startUtc) - sctx->now);
+
+	next = simulator_getNextUpdateTime(sctx);
+	*nextUtc = next == METERSIM_NO_UPDATE_SCHEDULED ? -1 : rctx->startUtc + next;
+	pthread_mutex_unlock(&rctx->lock);
+
+	return 0;
+}
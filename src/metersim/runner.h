@@ -17,11 +17,15 @@
 #include "metersim_types_int.h"
 #include "time_machine.h"
 #include "simulator.h"
+#include "latency.h"
 
 
 typedef enum {
 	runner_typeTimeMachine,
 	runner_typeCustomGetTime,
+	runner_typeLazy,   /* time machine clock without a thread, the simulator catches up on runner_update */
+	runner_typePushed, /* external clock pushing the time with runner_advanceTime, without a thread */
+	runner_typeGroup,  /* clock and thread of a runner group shared with other simulators */
 } runner_type_t;
 
 
@@ -36,10 +40,18 @@ typedef struct {
 
 	uint64_t (*getTimeCb)(void *args);
 	void *cbArgs;
+	int64_t startUtc; /* UTC time of the beginning of the simulation for a pushed runner */
+
+	struct metersim_group_s *group;
+	size_t heapIdx; /* position in the heap of the group */
+	int32_t wakeup; /* next wakeup time scheduled in the group */
 
 	timeMachine_ctx_t tmCtx;
 	simulator_ctx_t *sctx;
 
+	metersim_latency_t latency[METERSIM_LATENCY_KINDS];
+	metersim_runnerOpts_t opts; /* applied to the thread of the runner when it starts */
+
 	pthread_mutex_t lock;
 	pthread_cond_t cond;
 	pthread_t runnerThread;
@@ -52,6 +64,10 @@ void runner_update(runner_ctx_t *rctx);
 void runner_setSpeedup(runner_ctx_t *rctx, uint16_t speedup);
 
 
+/* Returns the speedup of the time machine or 1 for a custom time runner */
+uint16_t runner_getSpeedup(runner_ctx_t *rctx);
+
+
 void runner_resume(runner_ctx_t *rctx);
 
 
@@ -61,15 +77,31 @@ void runner_pause(runner_ctx_t *rctx, int32_t when);
 bool runner_isRunning(runner_ctx_t *rctx);
 
 
+/* Returns true if the time is driven from outside of the runner, by a group or by runner_advanceTime */
+bool runner_isDriven(runner_ctx_t *rctx);
+
+
 int32_t runner_getTime(runner_ctx_t *rctx);
 
 
 int64_t runner_getTimeUtc(runner_ctx_t *rctx);
 
 
+/* Returns the UTC time of uptime 0, consistent with runner_getTimeUtc at the same moment */
+int64_t runner_getStartUtc(runner_ctx_t *rctx);
+
+
 void runner_setTimeUtc(runner_ctx_t *rctx, int64_t time);
 
 
+/* Copies the latency histogram `kind` (METERSIM_LATENCY_*) */
+void runner_getLatency(runner_ctx_t *rctx, int kind, metersim_latency_t *ret);
+
+
+/* Sets the options of the thread started by runner_start. Returns -1 if they are invalid. */
+int runner_setOpts(runner_ctx_t *rctx, const metersim_runnerOpts_t *opts);
+
+
 int runner_start(runner_ctx_t *rctx);
 
 
@@ -79,6 +111,24 @@ void runner_finish(runner_ctx_t *rctx);
 runner_ctx_t *runner_init(simulator_ctx_t *sctx, uint64_t (*getTimeCb)(void *), void *args);
 
 
+runner_ctx_t *runner_initLazy(simulator_ctx_t *sctx, struct metersim_clock_s *clock);
+
+
+/* The runner is driven by `group` once started */
+runner_ctx_t *runner_initGroup(simulator_ctx_t *sctx, struct metersim_group_s *group);
+
+
+/* `nowUtc` is the UTC time of the current moment of the simulator */
+runner_ctx_t *runner_initPushed(simulator_ctx_t *sctx, int64_t nowUtc);
+
+
+/*
+ * Steps the simulator of a pushed runner to `utc` and writes the UTC time of its next event to `nextUtc`
+ * (-1 if none is scheduled). Returns -1 if `utc` is before the current time.
+ */
+int runner_advanceTime(runner_ctx_t *rctx, int64_t utc, int64_t *nextUtc);
+
+
 void runner_destroy(runner_ctx_t *rctx);
 
 #endif /* RUNNER_H */
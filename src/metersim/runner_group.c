@@ -0,0 +1,308 @@
+/*
+ * SEM simulator runner group
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+
+#include <metersim/metersim_types.h>
+#include "time_machine.h"
+#include "clocksrc.h"
+#include "simulator.h"
+#include "runner.h"
+#include "runner_group.h"
+#include "latency.h"
+#include "log.h"
+
+#define LOG_TAG "runnerGroup : "
+
+
+static void heapSwap(runnerGroup_t *group, size_t a, size_t b)
+{
+	runner_ctx_t *tmp = group->heap[a];
+	group->heap[a] = group->heap[b];
+	group->heap[b] = tmp;
+	group->heap[a]->heapIdx = a;
+	group->heap[b]->heapIdx = b;
+}
+
+
+/* Restores the order of the heap after the wakeup time of the member at `idx` changed */
+static void heapFix(runnerGroup_t *group, size_t idx)
+{
+	size_t child;
+
+	while (idx > 0 && group->heap[idx]->wakeup < group->heap[(idx - 1) / 2]->wakeup) {
+		heapSwap(group, idx, (idx - 1) / 2);
+		idx = (idx - 1) / 2;
+	}
+
+	for (;;) {
+		child = 2 * idx + 1;
+		if (child >= group->count) {
+			break;
+		}
+		if (child + 1 < group->count && group->heap[child + 1]->wakeup < group->heap[child]->wakeup) {
+			child++;
+		}
+		if (group->heap[idx]->wakeup <= group->heap[child]->wakeup) {
+			break;
+		}
+		heapSwap(group, idx, child);
+		idx = child;
+	}
+}
+
+
+/* Must be called with group->lock held */
+static void stepMember(runnerGroup_t *group, runner_ctx_t *rctx, int32_t now)
+{
+	simulator_ctx_t *sctx = rctx->sctx;
+
+	pthread_mutex_lock(&rctx->lock);
+	if (now > sctx->now) {
+		/* Pausing watchpoints cannot stop the clock shared with other simulators */
+		simulator_stepForward(sctx, now - sctx->now);
+	}
+	rctx->wakeup = simulator_getNextUpdateTime(sctx);
+	pthread_mutex_unlock(&rctx->lock);
+
+	heapFix(group, rctx->heapIdx);
+}
+
+
+static void *runnerGroupThread(void *arg)
+{
+	runnerGroup_t *group = (runnerGroup_t *)arg;
+	runner_ctx_t *first;
+	int32_t now, wakeup, due = METERSIM_NO_UPDATE_SCHEDULED;
+	struct timespec ts, woken;
+
+	pthread_mutex_lock(&group->lock);
+
+	log_debug("Starting group runner");
+	while (!group->shutdownFlag) {
+		now = timeMachine_gettime(&group->tmCtx);
+		while (group->count > 0 && group->heap[0]->wakeup <= now) {
+			first = group->heap[0];
+			wakeup = first->wakeup;
+			stepMember(group, first, now);
+			if (wakeup == due) {
+				/* The lock is held since the timed out wait, so this member was due at its deadline */
+				clocksrc_gettime(group->tmCtx.clock, &woken);
+				pthread_mutex_lock(&first->lock);
+				latency_record(&first->latency[METERSIM_LATENCY_STEP], latency_elapsed(&ts, &woken));
+				pthread_mutex_unlock(&first->lock);
+			}
+		}
+		due = METERSIM_NO_UPDATE_SCHEDULED;
+		pthread_cond_broadcast(&group->idle);
+
+		if (group->count == 0 || group->heap[0]->wakeup == METERSIM_NO_UPDATE_SCHEDULED) {
+			pthread_cond_wait(&group->cond, &group->lock);
+			continue;
+		}
+
+		wakeup = group->heap[0]->wakeup;
+		timeMachine_getWaitTime(&group->tmCtx, wakeup, &ts);
+		if (clocksrc_timedwait(group->tmCtx.clock, &group->cond, &group->lock, &ts) == ETIMEDOUT && group->count > 0) {
+			/* The lateness is accounted to the member that was waited for, if it is still first */
+			first = group->heap[0];
+			if (first->wakeup == wakeup) {
+				clocksrc_gettime(group->tmCtx.clock, &woken);
+				pthread_mutex_lock(&first->lock);
+				latency_record(&first->latency[METERSIM_LATENCY_WAKEUP], latency_elapsed(&ts, &woken));
+				pthread_mutex_unlock(&first->lock);
+			}
+			due = wakeup;
+		}
+	}
+	pthread_mutex_unlock(&group->lock);
+	log_debug("Finishing group runner");
+
+	return NULL;
+}
+
+
+void runnerGroup_update(runnerGroup_t *group, runner_ctx_t *rctx)
+{
+	pthread_mutex_lock(&group->lock);
+
+	/* Like the handshake of a runner thread, wakeups due by now are taken by the group thread */
+	while (!group->shutdownFlag && group->heap[0]->wakeup <= timeMachine_gettime(&group->tmCtx)) {
+		pthread_cond_signal(&group->cond);
+		pthread_cond_wait(&group->idle, &group->lock);
+	}
+	stepMember(group, rctx, timeMachine_gettime(&group->tmCtx));
+
+	/* A watchpoint or a device might have scheduled an earlier wakeup */
+	pthread_cond_signal(&group->cond);
+	pthread_mutex_unlock(&group->lock);
+}
+
+
+int runnerGroup_add(runnerGroup_t *group, runner_ctx_t *rctx)
+{
+	runner_ctx_t **heap;
+	size_t capacity;
+
+	pthread_mutex_lock(&group->lock);
+	if (rctx->sctx->now > timeMachine_gettime(&group->tmCtx)) {
+		pthread_mutex_unlock(&group->lock);
+		return -1;
+	}
+
+	if (group->count == group->capacity) {
+		capacity = group->capacity == 0 ? 16 : 2 * group->capacity;
+		heap = realloc(group->heap, capacity * sizeof(runner_ctx_t *));
+		if (heap == NULL) {
+			pthread_mutex_unlock(&group->lock);
+			return -1;
+		}
+		group->heap = heap;
+		group->capacity = capacity;
+	}
+
+	rctx->heapIdx = group->count;
+	rctx->wakeup = METERSIM_NO_UPDATE_SCHEDULED;
+	group->heap[group->count++] = rctx;
+	stepMember(group, rctx, timeMachine_gettime(&group->tmCtx));
+
+	pthread_cond_signal(&group->cond);
+	pthread_mutex_unlock(&group->lock);
+
+	return 0;
+}
+
+
+void runnerGroup_remove(runnerGroup_t *group, runner_ctx_t *rctx)
+{
+	size_t idx;
+
+	pthread_mutex_lock(&group->lock);
+	idx = rctx->heapIdx;
+	group->count--;
+	if (idx != group->count) {
+		heapSwap(group, idx, group->count);
+		heapFix(group, idx);
+	}
+	pthread_mutex_unlock(&group->lock);
+}
+
+
+void runnerGroup_setSpeedup(runnerGroup_t *group, uint16_t speedup)
+{
+	pthread_mutex_lock(&group->lock);
+	timeMachine_setSpeedup(&group->tmCtx, speedup);
+	pthread_cond_signal(&group->cond);
+	pthread_mutex_unlock(&group->lock);
+}
+
+
+uint16_t runnerGroup_getSpeedup(runnerGroup_t *group)
+{
+	uint16_t speedup;
+
+	pthread_mutex_lock(&group->lock);
+	speedup = (uint16_t)group->tmCtx.speedup;
+	pthread_mutex_unlock(&group->lock);
+
+	return speedup;
+}
+
+
+size_t runnerGroup_count(runnerGroup_t *group)
+{
+	size_t count;
+
+	pthread_mutex_lock(&group->lock);
+	count = group->count;
+	pthread_mutex_unlock(&group->lock);
+
+	return count;
+}
+
+
+runnerGroup_t *runnerGroup_init(uint16_t speedup, clocksrc_t *clock)
+{
+	pthread_condattr_t condAttr;
+	runnerGroup_t *group;
+
+	group = calloc(1, sizeof(runnerGroup_t));
+	if (group == NULL) {
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&group->lock, NULL) != 0) {
+		free(group);
+		return NULL;
+	}
+
+	if (pthread_condattr_init(&condAttr) != 0) {
+		pthread_mutex_destroy(&group->lock);
+		free(group);
+		return NULL;
+	}
+
+	if (pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC) != 0 || pthread_cond_init(&group->cond, &condAttr) != 0) {
+		pthread_condattr_destroy(&condAttr);
+		pthread_mutex_destroy(&group->lock);
+		free(group);
+		return NULL;
+	}
+	pthread_condattr_destroy(&condAttr);
+
+	if (pthread_cond_init(&group->idle, NULL) != 0) {
+		pthread_cond_destroy(&group->cond);
+		pthread_mutex_destroy(&group->lock);
+		free(group);
+		return NULL;
+	}
+
+	timeMachine_init(&group->tmCtx, speedup, clock);
+	timeMachine_start(&group->tmCtx, 0);
+
+	if (clocksrc_register(clock, &group->lock, &group->cond) < 0) {
+		pthread_cond_destroy(&group->idle);
+		pthread_cond_destroy(&group->cond);
+		pthread_mutex_destroy(&group->lock);
+		free(group);
+		return NULL;
+	}
+
+	if (pthread_create(&group->thread, NULL, runnerGroupThread, group) != 0) {
+		clocksrc_unregister(clock, &group->cond);
+		pthread_cond_destroy(&group->idle);
+		pthread_cond_destroy(&group->cond);
+		pthread_mutex_destroy(&group->lock);
+		free(group);
+		return NULL;
+	}
+
+	return group;
+}
+
+
+void runnerGroup_destroy(runnerGroup_t *group)
+{
+	pthread_mutex_lock(&group->lock);
+	group->shutdownFlag = true;
+	pthread_cond_signal(&group->cond);
+	pthread_mutex_unlock(&group->lock);
+
+	pthread_join(group->thread, NULL);
+	clocksrc_unregister(group->tmCtx.clock, &group->cond);
+	pthread_cond_destroy(&group->idle);
+	pthread_cond_destroy(&group->cond);
+	pthread_mutex_destroy(&group->lock);
+	free(group->heap);
+	free(group);
+}
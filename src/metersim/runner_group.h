@@ -0,0 +1,76 @@
+/*
+ * SEM simulator runner group API
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef RUNNER_GROUP_H
+#define RUNNER_GROUP_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <metersim/metersim.h>
+#include "time_machine.h"
+#include "clocksrc.h"
+#include "runner.h"
+
+
+/* One thread and one time machine clock driving the runners of many simulators */
+struct metersim_group_s {
+	timeMachine_ctx_t tmCtx;
+
+	runner_ctx_t **heap; /* members, binary min-heap ordered by their wakeup time */
+	size_t count;
+	size_t capacity;
+
+	bool shutdownFlag;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_cond_t idle; /* signalled when the thread has stepped all due members */
+	pthread_t thread;
+};
+
+typedef struct metersim_group_s runnerGroup_t;
+
+
+/*
+ * Waits until the group thread has stepped the members due at the time of the group clock, then steps
+ * the simulator of `rctx` to that time and reschedules its wakeup
+ */
+void runnerGroup_update(runnerGroup_t *group, runner_ctx_t *rctx);
+
+
+/*
+ * Adds a runner to the group, its simulator is stepped to the time of the group clock.
+ * Returns -1 if the simulator is ahead of the clock or on allocation failure.
+ */
+int runnerGroup_add(runnerGroup_t *group, runner_ctx_t *rctx);
+
+
+void runnerGroup_remove(runnerGroup_t *group, runner_ctx_t *rctx);
+
+
+void runnerGroup_setSpeedup(runnerGroup_t *group, uint16_t speedup);
+
+
+uint16_t runnerGroup_getSpeedup(runnerGroup_t *group);
+
+
+/* Returns the number of runners in the group */
+size_t runnerGroup_count(runnerGroup_t *group);
+
+
+/* Starts the group thread with the clock running from 0, `clock` is the source of the real time or NULL */
+runnerGroup_t *runnerGroup_init(uint16_t speedup, clocksrc_t *clock);
+
+
+void runnerGroup_destroy(runnerGroup_t *group);
+
+#endif /* RUNNER_GROUP_H */
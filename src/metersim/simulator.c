@@ -23,6 +23,17 @@
 #include "log.h"
 #include "calculator.h"
 #include "devicemgr.h"
+#include "demand.h"
+#include "loadprofile.h"
+#include "pqevent.h"
+#include "pqstats.h"
+#include "waveform.h"
+#include "pulse.h"
+#include "errormodel.h"
+#include "timeline.h"
+#include "watch.h"
+#include "notify.h"
+#include "history.h"
 
 
 #define LOG_TAG "simulator : "
@@ -35,6 +46,18 @@ static const metersim_scenario_t defaultScenario = {
 		.phaseCount = 3,
 		.tariffCount = 1,
 		.startTime = -1,
+		.demandPeriod = 900,
+		.demandSubperiods = 1,
+		.loadProfilePeriod = 0,
+		.loadProfileCapacity = 2880,
+		.pq = {
+			.nominalVoltage = 0,
+			.sagThreshold = 0.9,
+			.swellThreshold = 1.1,
+			.interruptionThreshold = 0.05,
+			.thdUThreshold = 0,
+			.thdIThreshold = 0,
+		},
 	},
 	.energy = NULL,
 };
@@ -54,28 +77,12 @@ static inline int32_t max(int32_t a, int32_t b)
 
 static void getValidUpdate(simulator_ctx_t *sctx)
 {
-	int status = 0;
-	metersim_update_t next;
-
-	for (;;) {
-		next = sctx->nextUpdate;
-
-		status = cfgparser_getUpdate(&sctx->cfgparserCtx, &next);
-
-		if (status < 0) {
-			continue;
-		}
-
-		if (status == 1) {
-			sctx->nextConfigUpdateTime = METERSIM_NO_UPDATE_SCHEDULED;
-			break;
-		}
-
-		if (next.timestamp > sctx->now && next.currentTariff < sctx->state.cfg.tariffCount) {
-			sctx->nextUpdate = next;
-			sctx->nextConfigUpdateTime = next.timestamp;
-			break;
-		}
+	/* Timeline holds only valid updates */
+	if (timeline_next(sctx->timeline, &sctx->cursor, &sctx->nextUpdate)) {
+		sctx->nextConfigUpdateTime = sctx->nextUpdate.timestamp;
+	}
+	else {
+		sctx->nextConfigUpdateTime = METERSIM_NO_UPDATE_SCHEDULED;
 	}
 }
 
@@ -85,6 +92,11 @@ int32_t simulator_getNextUpdateTime(simulator_ctx_t *sctx)
 	int32_t res;
 
 	res = min(devicemgr_getNextUpdateTime(sctx->devmgrCtx), sctx->nextConfigUpdateTime);
+	res = min(res, demand_getNextBoundary(&sctx->demand));
+	res = min(res, loadprofile_getNextCapture(&sctx->profile));
+	res = min(res, pqstats_getNextBoundary(&sctx->pqstats));
+	res = min(res, watch_getNextTime(&sctx->watch, &sctx->state, sctx->now));
+	res = min(res, notify_getNextTime(&sctx->notify, &sctx->state, sctx->now));
 	res = max(res, sctx->now);
 	return res;
 }
@@ -101,49 +113,241 @@ static void simulator_updateDevices(simulator_ctx_t *sctx, metersim_infoForDevic
 }
 
 
-void simulator_stepForward(simulator_ctx_t *sctx, int32_t seconds)
+/* Accumulates registers over a segment of constant state */
+static void simulator_accumulate(simulator_ctx_t *sctx, int32_t dt)
+{
+	calculator_accumulateEnergy(&sctx->state, dt);
+	demand_accumulate(&sctx->demand, &sctx->state, dt);
+	loadprofile_accumulate(&sctx->profile, &sctx->state, dt);
+	pqstats_accumulate(&sctx->pqstats, &sctx->state, dt);
+	pulse_accumulate(&sctx->pulse, &sctx->state, sctx->now, dt);
+}
+
+
+/* Handles periodic events scheduled at the current moment. Returns true if any was handled. */
+static bool simulator_handlePeriodic(simulator_ctx_t *sctx)
+{
+	bool handled = false;
+	metersim_energy_t total;
+
+	if (sctx->now == demand_getNextBoundary(&sctx->demand)) {
+		demand_closeSubperiod(&sctx->demand, sctx->state.currentTariff, sctx->now);
+		handled = true;
+	}
+
+	if (sctx->now == loadprofile_getNextCapture(&sctx->profile)) {
+		calculator_getEnergyTotal(&sctx->state, &total);
+		loadprofile_capture(&sctx->profile, sctx->now, &total);
+		handled = true;
+	}
+
+	if (sctx->now == pqstats_getNextBoundary(&sctx->pqstats)) {
+		pqstats_close(&sctx->pqstats, sctx->state.cfg.phaseCount, sctx->now);
+		handled = true;
+	}
+
+	return handled;
+}
+
+
+/* Recalculates the state after an update of the parameters or of the devices, `changed` is METERSIM_UPDATE_* */
+static void simulator_handleUpdate(simulator_ctx_t *sctx, unsigned int changed)
+{
+	if ((changed & (METERSIM_UPDATE_VOLTAGE | METERSIM_UPDATE_CURRENT)) != 0) {
+		calculator_handleUpdate(&sctx->state, &sctx->currUpdate, &sctx->bias);
+#ifdef METERSIM_ERROR_MODEL
+		errormodel_applyUpdate(&sctx->errormodel, &sctx->state);
+#endif
+	}
+	else {
+		calculator_handleScalarUpdate(&sctx->state, &sctx->currUpdate);
+	}
+	pqevent_check(&sctx->pq, &sctx->state, sctx->now);
+	history_record(&sctx->history, &sctx->state, sctx->now);
+}
+
+
+/*
+ * Must be called with sctx->lock held. If `stopOnWatch` is set, stops at the first triggered watchpoint
+ * without a callback and returns true.
+ */
+static bool stepForward(simulator_ctx_t *sctx, int32_t seconds, bool stopOnWatch)
 {
 	const int32_t end = sctx->now + seconds;
-	int32_t next, nextDeviceUpdateTime;
+	int32_t next, nextDeviceUpdateTime, nextWatchTime;
+	unsigned int changed;
+	bool periodic, deviceDue;
 
 	metersim_infoForDevice_t info;
 
 	assert(end >= sctx->now);
 
-	pthread_mutex_lock(&sctx->lock);
 	do {
 		next = min(simulator_getNextUpdateTime(sctx), end);
 		nextDeviceUpdateTime = devicemgr_getNextUpdateTime(sctx->devmgrCtx);
+		nextWatchTime = min(watch_getNextTime(&sctx->watch, &sctx->state, sctx->now),
+			notify_getNextTime(&sctx->notify, &sctx->state, sctx->now));
 
-		calculator_accumulateEnergy(&sctx->state, next - sctx->now);
+		simulator_accumulate(sctx, next - sctx->now);
 		sctx->now = next;
+
+		/* Periodic registers are closed before applying updates scheduled at the same moment */
+		periodic = simulator_handlePeriodic(sctx);
+
+		deviceDue = nextDeviceUpdateTime != METERSIM_NO_UPDATE_SCHEDULED && sctx->now >= nextDeviceUpdateTime;
+
 		if (sctx->now == sctx->nextConfigUpdateTime) {
 			sctx->currUpdate = sctx->nextUpdate;
-			calculator_prepareInfoForDevice(&sctx->currUpdate, &info);
+			changed = sctx->currUpdate.changed;
 			getValidUpdate(sctx);
 
-			simulator_updateDevices(sctx, &info);
-			calculator_handleUpdate(&sctx->state, &sctx->currUpdate, &sctx->bias);
+			/* Devices observe only the voltage, other columns do not concern them */
+			if (deviceDue || (changed & METERSIM_UPDATE_VOLTAGE) != 0) {
+				calculator_prepareInfoForDevice(&sctx->currUpdate, &info);
+				simulator_updateDevices(sctx, &info);
+				changed |= METERSIM_UPDATE_CURRENT;
+			}
+			simulator_handleUpdate(sctx, changed);
 		}
-		else if (nextDeviceUpdateTime != METERSIM_NO_UPDATE_SCHEDULED && sctx->now >= nextDeviceUpdateTime) {
+		else if (deviceDue) {
 			calculator_prepareInfoForDevice(&sctx->currUpdate, &info);
 			simulator_updateDevices(sctx, &info);
-			calculator_handleUpdate(&sctx->state, &sctx->currUpdate, &sctx->bias);
+			simulator_handleUpdate(sctx, METERSIM_UPDATE_CURRENT);
 		}
 		else {
-			assert(end == sctx->now);
+			assert(periodic || end == sctx->now || nextWatchTime == sctx->now);
+		}
+
+		notify_check(&sctx->notify, &sctx->state, sctx->now);
+
+		if (watch_check(&sctx->watch, &sctx->state, sctx->now) && stopOnWatch) {
+			readings_publish(&sctx->readings, &sctx->state, sctx->now);
+			return true;
 		}
 	} while (end > sctx->now);
-	pthread_mutex_unlock(&sctx->lock);
 
 	assert(end == sctx->now);
+	readings_publish(&sctx->readings, &sctx->state, sctx->now);
+	return false;
+}
+
+
+void simulator_stepForward(simulator_ctx_t *sctx, int32_t seconds)
+{
+	pthread_mutex_lock(&sctx->lock);
+	stepForward(sctx, seconds, false);
+	pthread_mutex_unlock(&sctx->lock);
+}
+
+
+bool simulator_stepForwardWatched(simulator_ctx_t *sctx, int32_t seconds)
+{
+	bool stopped;
+
+	pthread_mutex_lock(&sctx->lock);
+	stopped = stepForward(sctx, seconds, true);
+	pthread_mutex_unlock(&sctx->lock);
+
+	return stopped;
+}
+
+
+int simulator_addWatchpoint(simulator_ctx_t *sctx, int type, double threshold, void (*callback)(int, int32_t, void *), void *callbackCtx)
+{
+	int id;
+
+	pthread_mutex_lock(&sctx->lock);
+	id = watch_add(&sctx->watch, &sctx->state, type, threshold, callback, callbackCtx);
+	pthread_mutex_unlock(&sctx->lock);
+
+	return id < 0 ? METERSIM_ERROR : id;
+}
+
+
+int simulator_removeWatchpoint(simulator_ctx_t *sctx, int id)
+{
+	int status;
+
+	pthread_mutex_lock(&sctx->lock);
+	status = watch_remove(&sctx->watch, id);
+	pthread_mutex_unlock(&sctx->lock);
+
+	return status < 0 ? METERSIM_ERROR : METERSIM_SUCCESS;
+}
+
+
+bool simulator_hasPausingWatchpoint(simulator_ctx_t *sctx)
+{
+	bool ret;
+
+	pthread_mutex_lock(&sctx->lock);
+	ret = watch_hasPausing(&sctx->watch);
+	pthread_mutex_unlock(&sctx->lock);
+
+	return ret;
+}
+
+
+int simulator_subscribe(simulator_ctx_t *sctx, unsigned int fields, const metersim_deadband_t *deadband,
+	void (*callback)(int, unsigned int, int32_t, void *), void *callbackCtx, int fd)
+{
+	int id;
+
+	pthread_mutex_lock(&sctx->lock);
+	id = notify_add(&sctx->notify, &sctx->state, fields, deadband, callback, callbackCtx, fd);
+	pthread_mutex_unlock(&sctx->lock);
+
+	return id < 0 ? METERSIM_ERROR : id;
+}
+
+
+int simulator_unsubscribe(simulator_ctx_t *sctx, int id)
+{
+	int status;
+
+	pthread_mutex_lock(&sctx->lock);
+	status = notify_remove(&sctx->notify, id);
+	pthread_mutex_unlock(&sctx->lock);
+
+	return status < 0 ? METERSIM_ERROR : METERSIM_SUCCESS;
+}
+
+
+int simulator_stepAndSample(simulator_ctx_t *sctx, int32_t seconds, int32_t interval, unsigned int fields, metersim_sample_t *buf)
+{
+	const int count = seconds / interval;
+
+	pthread_mutex_lock(&sctx->lock);
+	for (int i = 0; i < count; i++) {
+		stepForward(sctx, interval, false);
+
+		buf[i].timestamp = sctx->now;
+		if ((fields & METERSIM_SAMPLE_INSTANT) != 0) {
+			buf[i].instant = sctx->state.instant;
+#ifdef METERSIM_ERROR_MODEL
+			errormodel_perturbInstant(&sctx->errormodel, &buf[i].instant);
+#endif
+		}
+		if ((fields & METERSIM_SAMPLE_POWER) != 0) {
+			buf[i].power = sctx->state.power;
+#ifdef METERSIM_ERROR_MODEL
+			errormodel_perturbPower(&sctx->errormodel, &buf[i].power);
+#endif
+		}
+		if ((fields & METERSIM_SAMPLE_ENERGY) != 0) {
+			calculator_getEnergyTotal(&sctx->state, &buf[i].energy);
+		}
+	}
+	stepForward(sctx, seconds - count * interval, false);
+	pthread_mutex_unlock(&sctx->lock);
+
+	return count;
 }
 
 
 simulator_ctx_t *simulator_init(const char *dir)
 {
 	simulator_ctx_t *sctx;
-	int ret = 0;
 
 	sctx = malloc(sizeof(simulator_ctx_t));
 	if (sctx == NULL) {
@@ -151,20 +355,12 @@ simulator_ctx_t *simulator_init(const char *dir)
 	}
 
 	*sctx = (simulator_ctx_t) {
-		.cfgparserCtx.updateFile = NULL,
 		.nextConfigUpdateTime = 0,
 		.now = -1
 	};
+	readings_init(&sctx->readings);
 
-	ret += cfgparser_init(&sctx->cfgparserCtx, dir);
-	if (ret < 0) {
-		free(sctx);
-		return NULL;
-	}
-
-	ret += pthread_mutex_init(&sctx->lock, NULL);
-	if (ret < 0) {
-		cfgparser_close(&sctx->cfgparserCtx);
+	if (pthread_mutex_init(&sctx->lock, NULL) != 0) {
 		free(sctx);
 		return NULL;
 	}
@@ -178,7 +374,6 @@ simulator_ctx_t *simulator_init(const char *dir)
 		scenario.energy = calloc(scenario.cfg.tariffCount, sizeof(metersim_energy_t[3]));
 		if (scenario.energy == NULL) {
 			pthread_mutex_destroy(&sctx->lock);
-			cfgparser_close(&sctx->cfgparserCtx);
 			free(sctx);
 			return NULL;
 		}
@@ -186,13 +381,85 @@ simulator_ctx_t *simulator_init(const char *dir)
 	if (scenario.cfg.startTime == -1) {
 		scenario.cfg.startTime = (int64_t)time(NULL);
 	}
+
 	calculator_initScenario(&sctx->state, &scenario);
 
+	sctx->timeline = timeline_load(dir, scenario.cfg.tariffCount, sctx->state.energy);
+	if (sctx->timeline == NULL) {
+		free(scenario.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		free(sctx);
+		return NULL;
+	}
+
+	demand_init(&sctx->demand, &sctx->state.cfg);
+	pqstats_init(&sctx->pqstats);
+	watch_init(&sctx->watch);
+	notify_init(&sctx->notify);
+#ifdef METERSIM_ERROR_MODEL
+	errormodel_init(&sctx->errormodel, &sctx->state.cfg);
+#endif
+
+	if (loadprofile_init(&sctx->profile, &sctx->state.cfg) < 0) {
+		timeline_release(sctx->timeline);
+		free(scenario.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		free(sctx);
+		return NULL;
+	}
+
+	if (pqevent_init(&sctx->pq, &sctx->state.cfg) < 0) {
+		loadprofile_destroy(&sctx->profile);
+		timeline_release(sctx->timeline);
+		free(scenario.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		free(sctx);
+		return NULL;
+	}
+
+	if (pulse_init(&sctx->pulse, &sctx->state.cfg) < 0) {
+		pqevent_destroy(&sctx->pq);
+		loadprofile_destroy(&sctx->profile);
+		timeline_release(sctx->timeline);
+		free(scenario.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		free(sctx);
+		return NULL;
+	}
+
+	if (history_init(&sctx->history, &sctx->state.cfg) < 0) {
+		pulse_destroy(&sctx->pulse);
+		pqevent_destroy(&sctx->pq);
+		loadprofile_destroy(&sctx->profile);
+		timeline_release(sctx->timeline);
+		free(scenario.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		free(sctx);
+		return NULL;
+	}
+
+	if (waveform_init(&sctx->waveform, &sctx->state.cfg) < 0) {
+		history_destroy(&sctx->history);
+		pulse_destroy(&sctx->pulse);
+		pqevent_destroy(&sctx->pq);
+		loadprofile_destroy(&sctx->profile);
+		timeline_release(sctx->timeline);
+		free(scenario.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		free(sctx);
+		return NULL;
+	}
+
 	sctx->devmgrCtx = devicemgr_init();
 	if (sctx->devmgrCtx == NULL) {
+		waveform_destroy(&sctx->waveform);
+		history_destroy(&sctx->history);
+		pulse_destroy(&sctx->pulse);
+		pqevent_destroy(&sctx->pq);
+		loadprofile_destroy(&sctx->profile);
+		timeline_release(sctx->timeline);
 		free(scenario.energy);
 		pthread_mutex_destroy(&sctx->lock);
-		cfgparser_close(&sctx->cfgparserCtx);
 		free(sctx);
 		return NULL;
 	}
@@ -205,29 +472,192 @@ simulator_ctx_t *simulator_init(const char *dir)
 }
 
 
+void simulator_reset(simulator_ctx_t *sctx)
+{
+	pthread_mutex_lock(&sctx->lock);
+
+	sctx->state = (metersim_state_t) {
+		.cfg = sctx->state.cfg,
+		.kernels = sctx->state.kernels,
+		.energy = sctx->state.energy
+	};
+	memcpy(sctx->state.energy, sctx->timeline->energy, sctx->state.cfg.tariffCount * sizeof(metersim_energy_t[3]));
+
+	sctx->cursor = (timeline_cursor_t) { 0 };
+	sctx->nextConfigUpdateTime = 0;
+	sctx->now = -1;
+	sctx->currUpdate = (metersim_update_t) { 0 };
+	sctx->nextUpdate = (metersim_update_t) { 0 };
+	sctx->bias = (calculator_bias_t) { 0 };
+
+	demand_init(&sctx->demand, &sctx->state.cfg);
+	pqstats_init(&sctx->pqstats);
+	waveform_reset(&sctx->waveform);
+#ifdef METERSIM_ERROR_MODEL
+	errormodel_init(&sctx->errormodel, &sctx->state.cfg);
+#endif
+	loadprofile_reset(&sctx->profile);
+	pqevent_reset(&sctx->pq);
+	pulse_reset(&sctx->pulse);
+	history_reset(&sctx->history);
+	devicemgr_reset(sctx->devmgrCtx);
+	watch_init(&sctx->watch);
+	notify_init(&sctx->notify);
+
+	getValidUpdate(sctx);
+	sctx->now = 0;
+	stepForward(sctx, 0, false); /* Calculate update at timestamp 0 */
+
+	pthread_mutex_unlock(&sctx->lock);
+}
+
+
+simulator_ctx_t *simulator_clone(simulator_ctx_t *src)
+{
+	simulator_ctx_t *sctx;
+	size_t energySize = src->state.cfg.tariffCount * sizeof(metersim_energy_t[3]);
+
+	sctx = malloc(sizeof(simulator_ctx_t));
+	if (sctx == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&src->lock);
+
+	/* Plain members are copied, owned resources are duplicated below */
+	*sctx = *src;
+	sctx->timeline = timeline_acquire(src->timeline);
+
+	/* Callbacks of the watchpoints and subscriptions are bound to the original */
+	watch_init(&sctx->watch);
+	notify_init(&sctx->notify);
+
+	if (pthread_mutex_init(&sctx->lock, NULL) != 0) {
+		pthread_mutex_unlock(&src->lock);
+		timeline_release(sctx->timeline);
+		free(sctx);
+		return NULL;
+	}
+
+	sctx->state.energy = malloc(energySize);
+	if (sctx->state.energy == NULL) {
+		pthread_mutex_unlock(&src->lock);
+		pthread_mutex_destroy(&sctx->lock);
+		timeline_release(sctx->timeline);
+		free(sctx);
+		return NULL;
+	}
+	memcpy(sctx->state.energy, src->state.energy, energySize);
+
+	if (loadprofile_clone(&sctx->profile, &src->profile) < 0) {
+		pthread_mutex_unlock(&src->lock);
+		free(sctx->state.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		timeline_release(sctx->timeline);
+		free(sctx);
+		return NULL;
+	}
+
+	/* Event logs of the clone start empty */
+	if (pqevent_init(&sctx->pq, &sctx->state.cfg) < 0) {
+		pthread_mutex_unlock(&src->lock);
+		loadprofile_destroy(&sctx->profile);
+		free(sctx->state.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		timeline_release(sctx->timeline);
+		free(sctx);
+		return NULL;
+	}
+	memcpy(sctx->pq.track, src->pq.track, sizeof(sctx->pq.track));
+
+	if (pulse_init(&sctx->pulse, &sctx->state.cfg) < 0) {
+		pthread_mutex_unlock(&src->lock);
+		pqevent_destroy(&sctx->pq);
+		loadprofile_destroy(&sctx->profile);
+		free(sctx->state.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		timeline_release(sctx->timeline);
+		free(sctx);
+		return NULL;
+	}
+	memcpy(sctx->pulse.residual, src->pulse.residual, sizeof(sctx->pulse.residual));
+
+	if (history_clone(&sctx->history, &src->history) < 0) {
+		pthread_mutex_unlock(&src->lock);
+		pulse_destroy(&sctx->pulse);
+		pqevent_destroy(&sctx->pq);
+		loadprofile_destroy(&sctx->profile);
+		free(sctx->state.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		timeline_release(sctx->timeline);
+		free(sctx);
+		return NULL;
+	}
+
+	/* Buffers are not shared, the clone continues the sample stream of the source */
+	if (waveform_init(&sctx->waveform, &sctx->state.cfg) < 0) {
+		pthread_mutex_unlock(&src->lock);
+		history_destroy(&sctx->history);
+		pulse_destroy(&sctx->pulse);
+		pqevent_destroy(&sctx->pq);
+		loadprofile_destroy(&sctx->profile);
+		free(sctx->state.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		timeline_release(sctx->timeline);
+		free(sctx);
+		return NULL;
+	}
+	sctx->waveform.nextSample = src->waveform.nextSample;
+	sctx->waveform.phase = src->waveform.phase;
+
+	sctx->devmgrCtx = devicemgr_clone(src->devmgrCtx);
+	pthread_mutex_unlock(&src->lock);
+
+	if (sctx->devmgrCtx == NULL) {
+		waveform_destroy(&sctx->waveform);
+		history_destroy(&sctx->history);
+		pulse_destroy(&sctx->pulse);
+		pqevent_destroy(&sctx->pq);
+		loadprofile_destroy(&sctx->profile);
+		free(sctx->state.energy);
+		pthread_mutex_destroy(&sctx->lock);
+		timeline_release(sctx->timeline);
+		free(sctx);
+		return NULL;
+	}
+
+	return sctx;
+}
+
+
 void simulator_destroy(simulator_ctx_t *sctx)
 {
 	devicemgr_destroy(sctx->devmgrCtx);
+	waveform_destroy(&sctx->waveform);
+	history_destroy(&sctx->history);
+	pulse_destroy(&sctx->pulse);
+	pqevent_destroy(&sctx->pq);
+	loadprofile_destroy(&sctx->profile);
 	free(sctx->state.energy);
 	pthread_mutex_destroy(&sctx->lock);
-	cfgparser_close(&sctx->cfgparserCtx);
+	timeline_release(sctx->timeline);
 	free(sctx);
 }
 
 
+/* The configuration does not change after initialization, its getters do not lock */
 void simulator_getTariffCount(simulator_ctx_t *sctx, int *retCount)
 {
-	pthread_mutex_lock(&sctx->lock);
 	*retCount = sctx->state.cfg.tariffCount;
-	pthread_mutex_unlock(&sctx->lock);
 }
 
 
 void simulator_getTariffCurrent(simulator_ctx_t *sctx, int *retIndex)
 {
-	pthread_mutex_lock(&sctx->lock);
-	*retIndex = sctx->state.currentTariff;
-	pthread_mutex_unlock(&sctx->lock);
+	uint8_t tariff;
+
+	readings_get(&sctx->readings, currentTariff, &tariff);
+	*retIndex = tariff;
 }
 
 
@@ -239,66 +669,46 @@ int simulator_getSerialNumber(simulator_ctx_t *sctx, int idx, char *dstBuf, size
 		return METERSIM_ERROR;
 	}
 
-	pthread_mutex_lock(&sctx->lock);
-
 	serialNumberLen = strlen(sctx->state.cfg.serialNumber);
 	strncpy(dstBuf, sctx->state.cfg.serialNumber, dstBufLen);
 
-	pthread_mutex_unlock(&sctx->lock);
-
 	return (int)serialNumberLen;
 }
 
 
 void simulator_getPhaseCount(simulator_ctx_t *sctx, int *retCount)
 {
-	pthread_mutex_lock(&sctx->lock);
 	*retCount = sctx->state.cfg.phaseCount;
-	pthread_mutex_unlock(&sctx->lock);
 }
 
 
 void simulator_getFrequency(simulator_ctx_t *sctx, float *retFreq)
 {
-	pthread_mutex_lock(&sctx->lock);
-	*retFreq = sctx->state.instant.frequency;
-	pthread_mutex_unlock(&sctx->lock);
+	readings_get(&sctx->readings, instant.frequency, retFreq);
 }
 
 
 void simulator_getMeterConstant(simulator_ctx_t *sctx, unsigned int *ret)
 {
-	pthread_mutex_lock(&sctx->lock);
 	*ret = sctx->state.cfg.meterConstant;
-	pthread_mutex_unlock(&sctx->lock);
 }
 
 
 void simulator_getInstant(simulator_ctx_t *sctx, metersim_instant_t *ret)
 {
+	readings_get(&sctx->readings, instant, ret);
+#ifdef METERSIM_ERROR_MODEL
+	/* The noise generator is a part of the simulator state */
 	pthread_mutex_lock(&sctx->lock);
-	*ret = sctx->state.instant;
+	errormodel_perturbInstant(&sctx->errormodel, ret);
 	pthread_mutex_unlock(&sctx->lock);
+#endif
 }
 
 
 void simulator_getEnergyTotal(simulator_ctx_t *sctx, metersim_energy_t *ret)
 {
-	*ret = (metersim_energy_t) { 0 };
-
-	pthread_mutex_lock(&sctx->lock);
-	for (int tariff = 0; tariff < sctx->state.cfg.tariffCount; tariff++) {
-		for (int phase = 0; phase < sctx->state.cfg.phaseCount; phase++) {
-			ret->activeMinus.value += sctx->state.energy[tariff][phase].activeMinus.value;
-			ret->activePlus.value += sctx->state.energy[tariff][phase].activePlus.value;
-			ret->apparentMinus.value += sctx->state.energy[tariff][phase].apparentMinus.value;
-			ret->apparentPlus.value += sctx->state.energy[tariff][phase].apparentPlus.value;
-			for (int i = 0; i < 4; i++) {
-				ret->reactive[i].value += sctx->state.energy[tariff][phase].reactive[i].value;
-			}
-		}
-	}
-	pthread_mutex_unlock(&sctx->lock);
+	readings_get(&sctx->readings, energyTotal, ret);
 }
 
 
@@ -323,25 +733,151 @@ int simulator_getEnergyTariff(simulator_ctx_t *sctx, metersim_energy_t ret[3], i
 }
 
 
-void simulator_getPower(simulator_ctx_t *sctx, metersim_power_t *ret)
+int simulator_getDemand(simulator_ctx_t *sctx, metersim_demand_t *ret, int idxTariff)
 {
+	int status;
+
 	pthread_mutex_lock(&sctx->lock);
-	*ret = sctx->state.power;
+	if (idxTariff >= 0 && idxTariff < sctx->state.cfg.tariffCount) {
+		demand_get(&sctx->demand, ret, idxTariff);
+		status = METERSIM_SUCCESS;
+	}
+	else {
+		status = METERSIM_ERROR;
+	}
 	pthread_mutex_unlock(&sctx->lock);
+
+	return status;
 }
 
 
-void simulator_getVector(simulator_ctx_t *sctx, metersim_vector_t *ret)
+size_t simulator_getLoadProfile(simulator_ctx_t *sctx, int32_t from, int32_t to, metersim_profileEntry_t *buf, size_t n)
 {
+	size_t ret;
+
 	pthread_mutex_lock(&sctx->lock);
-	*ret = sctx->state.vector;
+	ret = loadprofile_query(&sctx->profile, from, to, buf, n);
 	pthread_mutex_unlock(&sctx->lock);
+
+	return ret;
 }
 
 
-void simulator_getThd(simulator_ctx_t *sctx, metersim_thd_t *ret)
+int simulator_queryHistory(simulator_ctx_t *sctx, int field, int32_t from, int32_t to, metersim_historyPoint_t *buf, size_t n)
 {
+	int ret;
+
+	if (field < 0 || field >= METERSIM_HISTORY_FIELDS) {
+		return METERSIM_ERROR;
+	}
+
 	pthread_mutex_lock(&sctx->lock);
-	*ret = sctx->state.thd;
+	ret = (int)history_query(&sctx->history, field, from, to, buf, n);
 	pthread_mutex_unlock(&sctx->lock);
+
+	return ret;
+}
+
+
+int simulator_getPqStats(simulator_ctx_t *sctx, metersim_pqStats_t *ret, int window)
+{
+	if (window < 0 || window >= METERSIM_PQ_WINDOW_COUNT) {
+		return METERSIM_ERROR;
+	}
+
+	pthread_mutex_lock(&sctx->lock);
+	pqstats_get(&sctx->pqstats, ret, window);
+	pthread_mutex_unlock(&sctx->lock);
+
+	return METERSIM_SUCCESS;
+}
+
+
+int simulator_readWaveform(simulator_ctx_t *sctx, metersim_waveform_t *ret)
+{
+	int status;
+
+	pthread_mutex_lock(&sctx->lock);
+	status = waveform_generate(&sctx->waveform, &sctx->state, ret) < 0 ? METERSIM_ERROR : METERSIM_SUCCESS;
+	pthread_mutex_unlock(&sctx->lock);
+
+	return status;
+}
+
+
+size_t simulator_readPqEvents(simulator_ctx_t *sctx, metersim_pqEvent_t *buf, size_t n)
+{
+	/* Lock-free, the event log supports concurrent readers */
+	return pqevent_read(&sctx->pq, buf, n);
+}
+
+
+size_t simulator_readPulses(simulator_ctx_t *sctx, metersim_pulse_t *buf, size_t n)
+{
+	/* Lock-free, like the power quality event log */
+	return pulse_read(&sctx->pulse, buf, n);
+}
+
+
+void simulator_getPower(simulator_ctx_t *sctx, metersim_power_t *ret)
+{
+	readings_get(&sctx->readings, power, ret);
+#ifdef METERSIM_ERROR_MODEL
+	pthread_mutex_lock(&sctx->lock);
+	errormodel_perturbPower(&sctx->errormodel, ret);
+	pthread_mutex_unlock(&sctx->lock);
+#endif
+}
+
+
+void simulator_getVector(simulator_ctx_t *sctx, metersim_vector_t *ret)
+{
+	readings_get(&sctx->readings, vector, ret);
+}
+
+
+void simulator_getThd(simulator_ctx_t *sctx, metersim_thd_t *ret)
+{
+	readings_get(&sctx->readings, thd, ret);
+}
+
+
+void simulator_getSnapshot(simulator_ctx_t *sctx, unsigned int fields, metersim_snapshot_t *ret)
+{
+	readings_data_t data;
+
+	/* All groups come from the same publication */
+	readings_read(&sctx->readings, 0, sizeof(data), &data);
+
+	ret->timestamp = data.now;
+	ret->timeUtc = sctx->state.cfg.startTime + data.now;
+	ret->currentTariff = data.currentTariff;
+	if ((fields & METERSIM_SNAPSHOT_INSTANT) != 0) {
+		ret->instant = data.instant;
+	}
+	if ((fields & METERSIM_SNAPSHOT_POWER) != 0) {
+		ret->power = data.power;
+	}
+	if ((fields & METERSIM_SNAPSHOT_ENERGY) != 0) {
+		ret->energy = data.energyTotal;
+	}
+	if ((fields & METERSIM_SNAPSHOT_VECTOR) != 0) {
+		ret->vector = data.vector;
+	}
+	if ((fields & METERSIM_SNAPSHOT_THD) != 0) {
+		ret->thd = data.thd;
+	}
+
+#ifdef METERSIM_ERROR_MODEL
+	if ((fields & (METERSIM_SNAPSHOT_INSTANT | METERSIM_SNAPSHOT_POWER)) != 0) {
+		pthread_mutex_lock(&sctx->lock);
+		if ((fields & METERSIM_SNAPSHOT_INSTANT) != 0) {
+			errormodel_perturbInstant(&sctx->errormodel, &ret->instant);
+		}
+		if ((fields & METERSIM_SNAPSHOT_POWER) != 0) {
+			errormodel_perturbPower(&sctx->errormodel, &ret->power);
+		}
+		pthread_mutex_unlock(&sctx->lock);
+	}
+#endif
 }
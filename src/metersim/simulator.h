@@ -18,11 +18,24 @@
 #include "time_machine.h"
 #include <metersim/metersim_types.h>
 #include "devicemgr.h"
+#include "demand.h"
+#include "loadprofile.h"
+#include "pqevent.h"
+#include "pqstats.h"
+#include "waveform.h"
+#include "pulse.h"
+#include "errormodel.h"
+#include "timeline.h"
+#include "readings.h"
+#include "watch.h"
+#include "notify.h"
+#include "history.h"
 
 
 typedef struct {
 	metersim_state_t state;
-	cfgparser_ctx_t cfgparserCtx;
+	timeline_t *timeline; /* shared with clones */
+	timeline_cursor_t cursor;
 	int32_t now; /* virtual seconds elapsed from the beginning of the simulation */
 	int32_t nextConfigUpdateTime;
 	devicemgr_ctx_t *devmgrCtx;
@@ -32,6 +45,20 @@ typedef struct {
 
 	calculator_bias_t bias;
 
+	demand_ctx_t demand;
+	loadprofile_ctx_t profile;
+	pqevent_ctx_t pq;
+	pqstats_ctx_t pqstats;
+	waveform_ctx_t waveform;
+	pulse_ctx_t pulse;
+	watch_ctx_t watch;
+	notify_ctx_t notify;
+	history_ctx_t history;
+	readings_ctx_t readings; /* published at the end of each step */
+#ifdef METERSIM_ERROR_MODEL
+	errormodel_ctx_t errormodel;
+#endif
+
 	pthread_mutex_t lock;
 } simulator_ctx_t;
 
@@ -39,12 +66,45 @@ typedef struct {
 void simulator_stepForward(simulator_ctx_t *sctx, int32_t seconds);
 
 
+/* Steps forward like simulator_stepForward, but stops early at a pausing watchpoint. Returns true if it did. */
+bool simulator_stepForwardWatched(simulator_ctx_t *sctx, int32_t seconds);
+
+
+int simulator_addWatchpoint(simulator_ctx_t *sctx, int type, double threshold, void (*callback)(int, int32_t, void *), void *callbackCtx);
+
+
+int simulator_removeWatchpoint(simulator_ctx_t *sctx, int id);
+
+
+bool simulator_hasPausingWatchpoint(simulator_ctx_t *sctx);
+
+
+/* Returns nonnegative id of the subscription, or status code on error */
+int simulator_subscribe(simulator_ctx_t *sctx, unsigned int fields, const metersim_deadband_t *deadband,
+	void (*callback)(int, unsigned int, int32_t, void *), void *callbackCtx, int fd);
+
+
+int simulator_unsubscribe(simulator_ctx_t *sctx, int id);
+
+
+/* Steps forward by `seconds` taking a sample every `interval` seconds. Returns number of samples written to `buf`. */
+int simulator_stepAndSample(simulator_ctx_t *sctx, int32_t seconds, int32_t interval, unsigned int fields, metersim_sample_t *buf);
+
+
 int32_t simulator_getNextUpdateTime(simulator_ctx_t *sctx);
 
 
 simulator_ctx_t *simulator_init(const char *dir);
 
 
+/* Rewinds the simulator to the beginning of the scenario without reallocating. Devices are removed. */
+void simulator_reset(simulator_ctx_t *sctx);
+
+
+/* Duplicates the simulator at its current time. Scenario updates are shared, mutable state is copied. */
+simulator_ctx_t *simulator_clone(simulator_ctx_t *src);
+
+
 void simulator_destroy(simulator_ctx_t *sctx);
 
 
@@ -75,6 +135,29 @@ void simulator_getEnergyTotal(simulator_ctx_t *sctx, metersim_energy_t *ret);
 int simulator_getEnergyTariff(simulator_ctx_t *sctx, metersim_energy_t ret[3], int idxTariff);
 
 
+int simulator_getDemand(simulator_ctx_t *sctx, metersim_demand_t *ret, int idxTariff);
+
+
+size_t simulator_getLoadProfile(simulator_ctx_t *sctx, int32_t from, int32_t to, metersim_profileEntry_t *buf, size_t n);
+
+
+int simulator_queryHistory(simulator_ctx_t *sctx, int field, int32_t from, int32_t to, metersim_historyPoint_t *buf, size_t n);
+
+
+int simulator_getPqStats(simulator_ctx_t *sctx, metersim_pqStats_t *ret, int window);
+
+
+int simulator_readWaveform(simulator_ctx_t *sctx, metersim_waveform_t *ret);
+
+
+/* Does not take sctx->lock */
+size_t simulator_readPqEvents(simulator_ctx_t *sctx, metersim_pqEvent_t *buf, size_t n);
+
+
+/* Does not take sctx->lock */
+size_t simulator_readPulses(simulator_ctx_t *sctx, metersim_pulse_t *buf, size_t n);
+
+
 void simulator_getPower(simulator_ctx_t *sctx, metersim_power_t *ret);
 
 
@@ -83,4 +166,7 @@ void simulator_getVector(simulator_ctx_t *sctx, metersim_vector_t *ret);
 
 void simulator_getThd(simulator_ctx_t *sctx, metersim_thd_t *ret);
 
+
+void simulator_getSnapshot(simulator_ctx_t *sctx, unsigned int fields, metersim_snapshot_t *ret);
+
 #endif /* SIMULATOR_H */
@@ -0,0 +1,403 @@
+/*
+ * Saving and restoring state of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "simulator.h"
+#include "statefile.h"
+#include "log.h"
+
+#define LOG_TAG "statefile : "
+
+/*
+ * The file consists of a header followed by the fields in a fixed order, in the native byte order.
+ * Plain structures are stored as they are, so the layout word catches files written by a different build.
+ * Of the modules configured by the scenario only the dynamic fields are stored, with the configuration
+ * they were accumulated for, which has to match the loaded scenario.
+ */
+#define STATEFILE_MAGIC "SEMS"
+
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t layout;
+	uint8_t phaseCount;
+	uint8_t tariffCount;
+} statefile_header_t;
+
+
+/* Mixes the size of the next stored structure, unlike a sum it depends on the order */
+static uint32_t mixLayout(uint32_t layout, size_t size)
+{
+	return (layout ^ (uint32_t)size) * 16777619u;
+}
+
+
+static uint32_t getLayout(void)
+{
+	uint32_t layout = 2166136261u;
+
+	layout = mixLayout(layout, sizeof(metersim_update_t));
+	layout = mixLayout(layout, sizeof(metersim_instant_t));
+	layout = mixLayout(layout, sizeof(metersim_power_t));
+	layout = mixLayout(layout, sizeof(metersim_vector_t));
+	layout = mixLayout(layout, sizeof(metersim_thd_t));
+	layout = mixLayout(layout, sizeof(metersim_energy_t));
+	layout = mixLayout(layout, sizeof(pqstats_sketch_t));
+	layout = mixLayout(layout, sizeof(metersim_pqStats_t));
+	layout = mixLayout(layout, sizeof(metersim_profileEntry_t));
+	layout = mixLayout(layout, sizeof(pqevent_track_t));
+#ifdef METERSIM_ERROR_MODEL
+	layout = mixLayout(layout, sizeof(((errormodel_ctx_t *)0)->rng));
+#endif
+	return layout;
+}
+
+
+static bool put(FILE *f, const void *data, size_t size)
+{
+	return fwrite(data, size, 1, f) == 1;
+}
+
+
+static bool get(FILE *f, void *data, size_t size)
+{
+	return fread(data, size, 1, f) == 1;
+}
+
+
+static bool writeDemand(FILE *f, const demand_ctx_t *d)
+{
+	bool ok = true;
+
+	ok = ok && put(f, &d->subperiod, sizeof(d->subperiod));
+	ok = ok && put(f, &d->subperiodCount, sizeof(d->subperiodCount));
+	ok = ok && put(f, &d->nextBoundary, sizeof(d->nextBoundary));
+	ok = ok && put(f, d->energy, sizeof(d->energy));
+	ok = ok && put(f, d->window, sizeof(d->window));
+	ok = ok && put(f, d->windowSum, sizeof(d->windowSum));
+	ok = ok && put(f, &d->head, sizeof(d->head));
+	ok = ok && put(f, &d->filled, sizeof(d->filled));
+	ok = ok && put(f, d->last, sizeof(d->last));
+	ok = ok && put(f, d->max, sizeof(d->max));
+	ok = ok && put(f, d->maxTime, sizeof(d->maxTime));
+
+	return ok;
+}
+
+
+static bool readDemand(FILE *f, demand_ctx_t *d)
+{
+	int32_t subperiod;
+	uint8_t subperiodCount;
+	bool ok;
+
+	ok = get(f, &subperiod, sizeof(subperiod));
+	ok = ok && get(f, &subperiodCount, sizeof(subperiodCount));
+	if (ok && (subperiod != d->subperiod || subperiodCount != d->subperiodCount)) {
+		log_error("Demand configuration of the state file does not match the scenario");
+		return false;
+	}
+
+	ok = ok && get(f, &d->nextBoundary, sizeof(d->nextBoundary));
+	ok = ok && get(f, d->energy, sizeof(d->energy));
+	ok = ok && get(f, d->window, sizeof(d->window));
+	ok = ok && get(f, d->windowSum, sizeof(d->windowSum));
+	ok = ok && get(f, &d->head, sizeof(d->head));
+	ok = ok && get(f, &d->filled, sizeof(d->filled));
+	ok = ok && get(f, d->last, sizeof(d->last));
+	ok = ok && get(f, d->max, sizeof(d->max));
+	ok = ok && get(f, d->maxTime, sizeof(d->maxTime));
+
+	return ok;
+}
+
+
+static bool writePqStats(FILE *f, const pqstats_ctx_t *pqs)
+{
+	const pqstats_window_t *win;
+	bool ok = true;
+
+	for (int i = 0; ok && i < METERSIM_PQ_WINDOW_COUNT; i++) {
+		win = &pqs->window[i];
+		ok = ok && put(f, &win->length, sizeof(win->length));
+		ok = ok && put(f, &win->start, sizeof(win->start));
+		ok = ok && put(f, &win->nextEnd, sizeof(win->nextEnd));
+		ok = ok && put(f, win->sketch, sizeof(win->sketch));
+		ok = ok && put(f, &win->last, sizeof(win->last));
+	}
+
+	return ok;
+}
+
+
+static bool readPqStats(FILE *f, pqstats_ctx_t *pqs)
+{
+	pqstats_window_t *win;
+	int32_t length;
+	bool ok = true;
+
+	for (int i = 0; ok && i < METERSIM_PQ_WINDOW_COUNT; i++) {
+		win = &pqs->window[i];
+		ok = get(f, &length, sizeof(length));
+		if (ok && length != win->length) {
+			log_error("Aggregation windows of the state file do not match");
+			return false;
+		}
+		ok = ok && get(f, &win->start, sizeof(win->start));
+		ok = ok && get(f, &win->nextEnd, sizeof(win->nextEnd));
+		ok = ok && get(f, win->sketch, sizeof(win->sketch));
+		ok = ok && get(f, &win->last, sizeof(win->last));
+	}
+
+	return ok;
+}
+
+
+static bool writeProfile(FILE *f, const loadprofile_ctx_t *lp)
+{
+	bool ok = true;
+
+	ok = ok && put(f, &lp->period, sizeof(lp->period));
+	ok = ok && put(f, &lp->nextCapture, sizeof(lp->nextCapture));
+	ok = ok && put(f, &lp->frequency, sizeof(lp->frequency));
+	ok = ok && put(f, lp->voltage, sizeof(lp->voltage));
+	ok = ok && put(f, lp->current, sizeof(lp->current));
+	ok = ok && put(f, &lp->elapsed, sizeof(lp->elapsed));
+	ok = ok && put(f, &lp->count, sizeof(lp->count));
+	for (uint32_t i = 0; ok && i < lp->count; i++) {
+		ok = put(f, &lp->entries[(lp->head + lp->capacity - lp->count + i) % lp->capacity], sizeof(metersim_profileEntry_t));
+	}
+
+	return ok;
+}
+
+
+static bool readProfile(FILE *f, loadprofile_ctx_t *lp)
+{
+	metersim_profileEntry_t entry;
+	int32_t period;
+	uint32_t count;
+	bool ok;
+
+	ok = get(f, &period, sizeof(period));
+	if (ok && period != lp->period) {
+		log_error("Load profile configuration of the state file does not match the scenario");
+		return false;
+	}
+
+	ok = ok && get(f, &lp->nextCapture, sizeof(lp->nextCapture));
+	ok = ok && get(f, &lp->frequency, sizeof(lp->frequency));
+	ok = ok && get(f, lp->voltage, sizeof(lp->voltage));
+	ok = ok && get(f, lp->current, sizeof(lp->current));
+	ok = ok && get(f, &lp->elapsed, sizeof(lp->elapsed));
+	ok = ok && get(f, &count, sizeof(count));
+
+	/* Keep the newest entries if the capacity of the profile has changed */
+	lp->head = 0;
+	lp->count = 0;
+	for (uint32_t i = 0; ok && i < count; i++) {
+		ok = get(f, &entry, sizeof(entry));
+		if (ok && count - i <= lp->capacity) {
+			lp->entries[lp->head] = entry;
+			lp->head = (lp->head + 1) % lp->capacity;
+			lp->count++;
+		}
+	}
+
+	return ok;
+}
+
+
+static bool writeState(FILE *f, simulator_ctx_t *sctx, uint16_t speedup)
+{
+	const statefile_header_t header = {
+		.magic = STATEFILE_MAGIC,
+		.version = STATEFILE_VERSION,
+		.layout = getLayout(),
+		.phaseCount = sctx->state.cfg.phaseCount,
+		.tariffCount = sctx->state.cfg.tariffCount,
+	};
+	uint64_t cursor = sctx->cursor.row;
+	bool ok = true;
+
+	ok = ok && put(f, &header, sizeof(header));
+
+	/* Time and the cursor of the updates timeline */
+	ok = ok && put(f, &sctx->state.cfg.startTime, sizeof(sctx->state.cfg.startTime));
+	ok = ok && put(f, &speedup, sizeof(speedup));
+	ok = ok && put(f, &sctx->now, sizeof(sctx->now));
+	ok = ok && put(f, &sctx->nextConfigUpdateTime, sizeof(sctx->nextConfigUpdateTime));
+	ok = ok && put(f, &cursor, sizeof(cursor));
+	ok = ok && put(f, &sctx->currUpdate, sizeof(sctx->currUpdate));
+	ok = ok && put(f, &sctx->nextUpdate, sizeof(sctx->nextUpdate));
+
+	/* Calculated state and registers */
+	ok = ok && put(f, &sctx->state.currentTariff, sizeof(sctx->state.currentTariff));
+	ok = ok && put(f, &sctx->state.instant, sizeof(sctx->state.instant));
+	ok = ok && put(f, &sctx->state.power, sizeof(sctx->state.power));
+	ok = ok && put(f, &sctx->state.vector, sizeof(sctx->state.vector));
+	ok = ok && put(f, &sctx->state.thd, sizeof(sctx->state.thd));
+	ok = ok && put(f, sctx->state.energy, sctx->state.cfg.tariffCount * sizeof(metersim_energy_t[3]));
+
+	/* Periodic registers */
+	ok = ok && writeDemand(f, &sctx->demand);
+	ok = ok && writePqStats(f, &sctx->pqstats);
+	ok = ok && writeProfile(f, &sctx->profile);
+
+	/* Detectors and generators */
+	ok = ok && put(f, sctx->pq.track, sizeof(sctx->pq.track));
+	ok = ok && put(f, sctx->pulse.residual, sizeof(sctx->pulse.residual));
+	ok = ok && put(f, &sctx->waveform.nextSample, sizeof(sctx->waveform.nextSample));
+	ok = ok && put(f, &sctx->waveform.phase, sizeof(sctx->waveform.phase));
+#ifdef METERSIM_ERROR_MODEL
+	ok = ok && put(f, sctx->errormodel.rng, sizeof(sctx->errormodel.rng));
+#endif
+
+	return ok;
+}
+
+
+static bool readState(FILE *f, simulator_ctx_t *sctx, uint16_t *speedup)
+{
+	statefile_header_t header;
+	uint64_t cursor;
+	bool ok;
+
+	if (!get(f, &header, sizeof(header))) {
+		return false;
+	}
+	if (memcmp(header.magic, STATEFILE_MAGIC, sizeof(header.magic)) != 0 || header.version != STATEFILE_VERSION || header.layout != getLayout()) {
+		log_error("Unsupported state file");
+		return false;
+	}
+	if (header.phaseCount != sctx->state.cfg.phaseCount || header.tariffCount != sctx->state.cfg.tariffCount) {
+		log_error("State file does not match the scenario");
+		return false;
+	}
+
+	ok = get(f, &sctx->state.cfg.startTime, sizeof(sctx->state.cfg.startTime));
+	ok = ok && get(f, speedup, sizeof(*speedup));
+	ok = ok && get(f, &sctx->now, sizeof(sctx->now));
+	ok = ok && get(f, &sctx->nextConfigUpdateTime, sizeof(sctx->nextConfigUpdateTime));
+	ok = ok && get(f, &cursor, sizeof(cursor));
+	ok = ok && get(f, &sctx->currUpdate, sizeof(sctx->currUpdate));
+	ok = ok && get(f, &sctx->nextUpdate, sizeof(sctx->nextUpdate));
+
+	ok = ok && get(f, &sctx->state.currentTariff, sizeof(sctx->state.currentTariff));
+	ok = ok && get(f, &sctx->state.instant, sizeof(sctx->state.instant));
+	ok = ok && get(f, &sctx->state.power, sizeof(sctx->state.power));
+	ok = ok && get(f, &sctx->state.vector, sizeof(sctx->state.vector));
+	ok = ok && get(f, &sctx->state.thd, sizeof(sctx->state.thd));
+	ok = ok && get(f, sctx->state.energy, sctx->state.cfg.tariffCount * sizeof(metersim_energy_t[3]));
+
+	ok = ok && readDemand(f, &sctx->demand);
+	ok = ok && readPqStats(f, &sctx->pqstats);
+	ok = ok && readProfile(f, &sctx->profile);
+
+	ok = ok && get(f, sctx->pq.track, sizeof(sctx->pq.track));
+	ok = ok && get(f, sctx->pulse.residual, sizeof(sctx->pulse.residual));
+	ok = ok && get(f, &sctx->waveform.nextSample, sizeof(sctx->waveform.nextSample));
+	ok = ok && get(f, &sctx->waveform.phase, sizeof(sctx->waveform.phase));
+#ifdef METERSIM_ERROR_MODEL
+	ok = ok && get(f, sctx->errormodel.rng, sizeof(sctx->errormodel.rng));
+#endif
+
+	if (!ok) {
+		log_error("State file is truncated");
+		return false;
+	}
+
+	if (cursor != (size_t)cursor || timeline_seek(sctx->timeline, &sctx->cursor, (size_t)cursor) < 0) {
+		log_error("State file does not match the updates file");
+		return false;
+	}
+
+	/* Devices are not restored, so neither is their influence on the currents */
+	sctx->bias = (calculator_bias_t) { 0 };
+
+	/* Events and pulses emitted by the initialization are not part of the restored state */
+	if (sctx->pq.enabled) {
+		ring_clear(&sctx->pq.log);
+	}
+	if (sctx->pulse.enabled) {
+		ring_clear(&sctx->pulse.log);
+	}
+
+	return true;
+}
+
+
+int statefile_save(simulator_ctx_t *sctx, uint16_t speedup, const char *path)
+{
+	FILE *f;
+	char *tmpPath;
+	bool ok;
+
+	tmpPath = malloc(strlen(path) + sizeof(".tmp"));
+	if (tmpPath == NULL) {
+		return -1;
+	}
+	sprintf(tmpPath, "%s.tmp", path);
+
+	f = fopen(tmpPath, "wb");
+	if (f == NULL) {
+		log_error("Cannot open %s", tmpPath);
+		free(tmpPath);
+		return -1;
+	}
+
+	pthread_mutex_lock(&sctx->lock);
+	ok = writeState(f, sctx, speedup);
+	pthread_mutex_unlock(&sctx->lock);
+
+	ok = (fclose(f) == 0) && ok;
+	if (ok && rename(tmpPath, path) != 0) {
+		ok = false;
+	}
+	if (!ok) {
+		log_error("Could not write state to %s", path);
+		remove(tmpPath);
+	}
+
+	free(tmpPath);
+	return ok ? 0 : -1;
+}
+
+
+int statefile_load(simulator_ctx_t *sctx, const char *path)
+{
+	FILE *f;
+	uint16_t speedup;
+	bool ok;
+
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		log_error("Cannot open %s", path);
+		return -1;
+	}
+
+	pthread_mutex_lock(&sctx->lock);
+	ok = readState(f, sctx, &speedup);
+	if (ok) {
+		sctx->state.cfg.speedup = speedup;
+		readings_publish(&sctx->readings, &sctx->state, sctx->now);
+	}
+	pthread_mutex_unlock(&sctx->lock);
+
+	fclose(f);
+	return ok ? 0 : -1;
+}
@@ -0,0 +1,27 @@
+/*
+ * Saving and restoring state of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef STATEFILE_H
+#define STATEFILE_H
+
+#include <stdint.h>
+
+#include "simulator.h"
+
+#define STATEFILE_VERSION 5
+
+
+/* Writes the state of the simulator to `path`. The file is replaced atomically. */
+int statefile_save(simulator_ctx_t *sctx, uint16_t speedup, const char *path);
+
+
+/* Restores the state of a simulator freshly initialized from the same scenario directory */
+int statefile_load(simulator_ctx_t *sctx, const char *path);
+
+#endif /* STATEFILE_H */
@@ -15,6 +15,7 @@
 #include <assert.h>
 
 #include "time_machine.h"
+#include "clocksrc.h"
 #include "log.h"
 
 #define LOG_TAG             "timeMachine : "
@@ -46,7 +47,7 @@ int32_t timeMachine_gettime(timeMachine_ctx_t *ctx)
 {
 	struct timespec now;
 	int32_t ret;
-	clock_gettime(CLOCK_MONOTONIC, &now);
+	clocksrc_gettime(ctx->clock, &now);
 
 	ret = getSimulatedSeconds(&ctx->lastSwitchReal, &now, ctx->speedup) + ctx->lastSwitch;
 	ret = min(ret, ctx->stopTime);
@@ -56,12 +57,12 @@ int32_t timeMachine_gettime(timeMachine_ctx_t *ctx)
 
 void timeMachine_getWaitTime(timeMachine_ctx_t *ctx, int32_t wakeUpTime, struct timespec *ret)
 {
-	int32_t sec = wakeUpTime - timeMachine_gettime(ctx);
+	/* The deadline is derived from the anchor of the clock, so errors of previous waits do not accumulate */
+	int64_t nsec = ((int64_t)(wakeUpTime - ctx->lastSwitch) * NSEC_PER_SEC + ctx->speedup - 1) / ctx->speedup;
 
-	assert(sec >= 0);
-	clock_gettime(CLOCK_MONOTONIC, ret);
-	ret->tv_sec += sec / ctx->speedup;
-	ret->tv_nsec += (int64_t)(sec % ctx->speedup) * NSEC_PER_SEC / ctx->speedup;
+	assert(wakeUpTime >= timeMachine_gettime(ctx));
+	ret->tv_sec = ctx->lastSwitchReal.tv_sec + nsec / NSEC_PER_SEC;
+	ret->tv_nsec = ctx->lastSwitchReal.tv_nsec + nsec % NSEC_PER_SEC;
 	if (ret->tv_nsec >= NSEC_PER_SEC) {
 		ret->tv_nsec -= NSEC_PER_SEC;
 		ret->tv_sec += 1;
@@ -73,7 +74,7 @@ void timeMachine_setSpeedup(timeMachine_ctx_t *ctx, int speedup)
 {
 	struct timespec realNow;
 	int32_t virtualNow;
-	clock_gettime(CLOCK_MONOTONIC, &realNow);
+	clocksrc_gettime(ctx->clock, &realNow);
 
 	virtualNow = getSimulatedSeconds(&ctx->lastSwitchReal, &realNow, ctx->speedup) + ctx->lastSwitch;
 	ctx->lastSwitch = min(virtualNow, ctx->stopTime);
@@ -84,7 +85,7 @@ void timeMachine_setSpeedup(timeMachine_ctx_t *ctx, int speedup)
 
 void timeMachine_start(timeMachine_ctx_t *ctx, int32_t now)
 {
-	clock_gettime(CLOCK_MONOTONIC, &ctx->start);
+	clocksrc_gettime(ctx->clock, &ctx->start);
 	ctx->lastSwitch = now;
 	ctx->lastSwitchReal = ctx->start;
 
@@ -102,17 +103,26 @@ int32_t timeMachine_setStop(timeMachine_ctx_t *ctx, int32_t stopTime)
 }
 
 
+void timeMachine_stopAt(timeMachine_ctx_t *ctx, int32_t now)
+{
+	clocksrc_gettime(ctx->clock, &ctx->lastSwitchReal);
+	ctx->lastSwitch = now;
+	ctx->stopTime = now;
+}
+
+
 bool timeMachine_isStopped(timeMachine_ctx_t *ctx)
 {
 	return ctx->stopTime == timeMachine_gettime(ctx);
 }
 
 
-void timeMachine_init(timeMachine_ctx_t *ctx, int speedup)
+void timeMachine_init(timeMachine_ctx_t *ctx, int speedup, clocksrc_t *clock)
 {
+	ctx->clock = clock;
 	ctx->speedup = speedup;
 	ctx->stopTime = 0;
-	clock_gettime(CLOCK_MONOTONIC, &ctx->start);
+	clocksrc_gettime(ctx->clock, &ctx->start);
 	ctx->lastSwitch = 0;
 	ctx->lastSwitchReal = ctx->start;
 }
@@ -14,6 +14,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "clocksrc.h"
+
 
 typedef struct {
 	struct timespec start;
@@ -21,12 +23,14 @@ typedef struct {
 	struct timespec lastSwitchReal;
 	int speedup;
 	int32_t stopTime;
+	clocksrc_t *clock; /* source of the real time, NULL for CLOCK_MONOTONIC */
 } timeMachine_ctx_t;
 
 
 int32_t timeMachine_gettime(timeMachine_ctx_t *ctx);
 
 
+/* Absolute time of the clock source at which the virtual time reaches `wakeUpTime` */
 void timeMachine_getWaitTime(timeMachine_ctx_t *ctx, int32_t wakeUpTime, struct timespec *ret);
 
 
@@ -39,9 +43,13 @@ void timeMachine_start(timeMachine_ctx_t *ctx, int32_t now);
 int32_t timeMachine_setStop(timeMachine_ctx_t *ctx, int32_t stopTime);
 
 
+/* Sets the virtual time back to `now` and stops there */
+void timeMachine_stopAt(timeMachine_ctx_t *ctx, int32_t now);
+
+
 bool timeMachine_isStopped(timeMachine_ctx_t *ctx);
 
 
-void timeMachine_init(timeMachine_ctx_t *ctx, int speedup);
+void timeMachine_init(timeMachine_ctx_t *ctx, int speedup, clocksrc_t *clock);
 
 #endif /* TIME_MACHINE_H */
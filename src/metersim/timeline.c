@@ -0,0 +1,321 @@
+/*
+ * In-memory timeline of scenario updates
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "cfgparser.h"
+#include "timeline.h"
+#include "log.h"
+
+#define LOG_TAG "timeline : "
+
+#define TIMELINE_INITIAL_CAPACITY 64
+
+/* Bit positions of METERSIM_UPDATE_*, GROUP_ALL for columns with an entry per update */
+#define GROUP_ALL       -1
+#define GROUP_TARIFF    0
+#define GROUP_FREQUENCY 1
+#define GROUP_THD       2
+#define GROUP_VOLTAGE   3
+#define GROUP_CURRENT   4
+
+#define COLUMN(col, fld, grp) \
+	{ offsetof(timeline_t, col), offsetof(metersim_update_t, fld), sizeof(((metersim_update_t *)0)->fld), grp }
+
+
+static const struct {
+	size_t column; /* offset of the column pointer in timeline_t */
+	size_t field;  /* offset of the value in metersim_update_t */
+	size_t size;
+	int group;
+} columns[] = {
+	COLUMN(timestamp, timestamp, GROUP_ALL),
+	COLUMN(changed, changed, GROUP_ALL),
+	COLUMN(tariff, currentTariff, GROUP_TARIFF),
+	COLUMN(frequency, instant.frequency, GROUP_FREQUENCY),
+	COLUMN(thdU[0], thd.thdU[0], GROUP_THD),
+	COLUMN(thdU[1], thd.thdU[1], GROUP_THD),
+	COLUMN(thdU[2], thd.thdU[2], GROUP_THD),
+	COLUMN(thdI[0], thd.thdI[0], GROUP_THD),
+	COLUMN(thdI[1], thd.thdI[1], GROUP_THD),
+	COLUMN(thdI[2], thd.thdI[2], GROUP_THD),
+	COLUMN(voltage[0], instant.voltage[0], GROUP_VOLTAGE),
+	COLUMN(voltage[1], instant.voltage[1], GROUP_VOLTAGE),
+	COLUMN(voltage[2], instant.voltage[2], GROUP_VOLTAGE),
+	COLUMN(current[0], instant.current[0], GROUP_CURRENT),
+	COLUMN(current[1], instant.current[1], GROUP_CURRENT),
+	COLUMN(current[2], instant.current[2], GROUP_CURRENT),
+	COLUMN(uiAngle[0], instant.uiAngle[0], GROUP_CURRENT),
+	COLUMN(uiAngle[1], instant.uiAngle[1], GROUP_CURRENT),
+	COLUMN(uiAngle[2], instant.uiAngle[2], GROUP_CURRENT),
+};
+
+#define COLUMN_COUNT (sizeof(columns) / sizeof(columns[0]))
+
+
+/* Column pointers have different types, they are accessed by copying */
+static inline void *getColumn(const timeline_t *tl, size_t i)
+{
+	void *col;
+	memcpy(&col, (const char *)tl + columns[i].column, sizeof(col));
+	return col;
+}
+
+
+static inline void setColumn(timeline_t *tl, size_t i, void *col)
+{
+	memcpy((char *)tl + columns[i].column, &col, sizeof(col));
+}
+
+
+static inline size_t getLength(const timeline_t *tl, size_t i)
+{
+	return columns[i].group == GROUP_ALL ? tl->count : tl->entries[columns[i].group];
+}
+
+
+/* Appends the value from `upd` as the entry `idx`, capacity doubles at powers of two */
+static int push(timeline_t *tl, size_t i, size_t idx, const metersim_update_t *upd)
+{
+	char *col = getColumn(tl, i);
+	size_t size = columns[i].size;
+
+	if (idx == 0) {
+		col = malloc(TIMELINE_INITIAL_CAPACITY * size);
+	}
+	else if (idx >= TIMELINE_INITIAL_CAPACITY && (idx & (idx - 1)) == 0) {
+		col = realloc(col, 2 * idx * size);
+	}
+
+	if (col == NULL) {
+		return -1;
+	}
+	setColumn(tl, i, col);
+
+	memcpy(col + idx * size, (const char *)upd + columns[i].field, size);
+	return 0;
+}
+
+
+static int append(timeline_t *tl, const metersim_update_t *upd)
+{
+	size_t i;
+	int group;
+
+	for (i = 0; i < COLUMN_COUNT; i++) {
+		group = columns[i].group;
+		if (group == GROUP_ALL) {
+			if (push(tl, i, tl->count, upd) < 0) {
+				return -1;
+			}
+		}
+		else if ((upd->changed & (1u << group)) != 0) {
+			if (push(tl, i, tl->entries[group], upd) < 0) {
+				return -1;
+			}
+		}
+	}
+
+	for (group = 0; group < TIMELINE_GROUPS; group++) {
+		if ((upd->changed & (1u << group)) != 0) {
+			tl->entries[group]++;
+		}
+	}
+	tl->count++;
+
+	return 0;
+}
+
+
+/* Releases the unused capacity of the columns once the timeline is complete */
+static void shrink(timeline_t *tl)
+{
+	size_t i, len;
+	void *col;
+
+	for (i = 0; i < COLUMN_COUNT; i++) {
+		len = getLength(tl, i);
+		if (len == 0) {
+			continue;
+		}
+		col = realloc(getColumn(tl, i), len * columns[i].size);
+		if (col != NULL) {
+			setColumn(tl, i, col);
+		}
+	}
+}
+
+
+static void destroy(timeline_t *tl)
+{
+	size_t i;
+
+	for (i = 0; i < COLUMN_COUNT; i++) {
+		free(getColumn(tl, i));
+	}
+	free(tl->energy);
+	free(tl);
+}
+
+
+static uint8_t getChanged(const metersim_update_t *prev, const metersim_update_t *next)
+{
+	uint8_t changed = 0;
+
+	if (next->currentTariff != prev->currentTariff) {
+		changed |= METERSIM_UPDATE_TARIFF;
+	}
+	if (next->instant.frequency != prev->instant.frequency) {
+		changed |= METERSIM_UPDATE_FREQUENCY;
+	}
+	if (memcmp(&next->thd, &prev->thd, sizeof(next->thd)) != 0) {
+		changed |= METERSIM_UPDATE_THD;
+	}
+	if (memcmp(next->instant.voltage, prev->instant.voltage, sizeof(next->instant.voltage)) != 0) {
+		changed |= METERSIM_UPDATE_VOLTAGE;
+	}
+	if (memcmp(next->instant.current, prev->instant.current, sizeof(next->instant.current)) != 0 ||
+			memcmp(next->instant.uiAngle, prev->instant.uiAngle, sizeof(next->instant.uiAngle)) != 0) {
+		changed |= METERSIM_UPDATE_CURRENT;
+	}
+
+	return changed;
+}
+
+
+timeline_t *timeline_load(const char *dir, uint8_t tariffCount, metersim_energy_t (*energy)[3])
+{
+	cfgparser_ctx_t parser = { .updateFile = NULL };
+	metersim_update_t next, prev = { .timestamp = -1 };
+	int status;
+
+	timeline_t *tl = calloc(1, sizeof(timeline_t));
+	if (tl == NULL) {
+		return NULL;
+	}
+	tl->refs = 1;
+
+	tl->energy = malloc(tariffCount * sizeof(metersim_energy_t[3]));
+	if (tl->energy == NULL) {
+		destroy(tl);
+		return NULL;
+	}
+	memcpy(tl->energy, energy, tariffCount * sizeof(metersim_energy_t[3]));
+
+	if (cfgparser_init(&parser, dir) < 0) {
+		destroy(tl);
+		return NULL;
+	}
+
+	for (;;) {
+		/* Empty cells keep values of the previous valid update */
+		next = prev;
+		status = cfgparser_getUpdate(&parser, &next);
+
+		if (status == 1) {
+			break;
+		}
+
+		if (status < 0 || next.timestamp <= prev.timestamp || next.currentTariff >= tariffCount) {
+			continue;
+		}
+
+		next.changed = tl->count == 0 ? METERSIM_UPDATE_ALL : getChanged(&prev, &next);
+		if (append(tl, &next) < 0) {
+			log_error("Could not allocate memory for updates");
+			cfgparser_close(&parser);
+			destroy(tl);
+			return NULL;
+		}
+		prev = next;
+	}
+
+	cfgparser_close(&parser);
+	shrink(tl);
+
+	return tl;
+}
+
+
+timeline_t *timeline_acquire(timeline_t *tl)
+{
+	__atomic_fetch_add(&tl->refs, 1, __ATOMIC_RELAXED);
+	return tl;
+}
+
+
+void timeline_release(timeline_t *tl)
+{
+	if (__atomic_sub_fetch(&tl->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		destroy(tl);
+	}
+}
+
+
+bool timeline_next(const timeline_t *tl, timeline_cursor_t *cur, metersim_update_t *upd)
+{
+	uint8_t changed;
+	size_t i, idx;
+	int group;
+
+	if (cur->row >= tl->count) {
+		return false;
+	}
+
+	changed = tl->changed[cur->row];
+	for (i = 0; i < COLUMN_COUNT; i++) {
+		group = columns[i].group;
+		if (group == GROUP_ALL) {
+			idx = cur->row;
+		}
+		else if ((changed & (1u << group)) != 0) {
+			idx = cur->entry[group];
+		}
+		else {
+			continue;
+		}
+		memcpy((char *)upd + columns[i].field, (const char *)getColumn(tl, i) + idx * columns[i].size, columns[i].size);
+	}
+
+	for (group = 0; group < TIMELINE_GROUPS; group++) {
+		if ((changed & (1u << group)) != 0) {
+			cur->entry[group]++;
+		}
+	}
+	cur->row++;
+
+	return true;
+}
+
+
+int timeline_seek(const timeline_t *tl, timeline_cursor_t *cur, size_t row)
+{
+	size_t i;
+	int group;
+
+	if (row > tl->count) {
+		return -1;
+	}
+
+	*cur = (timeline_cursor_t) { .row = row };
+	for (i = 0; i < row; i++) {
+		for (group = 0; group < TIMELINE_GROUPS; group++) {
+			if ((tl->changed[i] & (1u << group)) != 0) {
+				cur->entry[group]++;
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * In-memory timeline of scenario updates
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+
+/* Number of METERSIM_UPDATE_* groups */
+#define TIMELINE_GROUPS 5
+
+
+/*
+ * Valid updates of the scenario with strictly increasing timestamps, stored as columns.
+ * Timestamps and change masks have an entry per update, the values of a METERSIM_UPDATE_* group
+ * have an entry only per update changing the group. Read-only once loaded, shared by clones
+ * of a simulator.
+ */
+typedef struct {
+	uint32_t refs;
+	size_t count;
+	size_t entries[TIMELINE_GROUPS]; /* number of updates changing each group */
+
+	int32_t *timestamp;
+	uint8_t *changed;
+
+	uint8_t *tariff;
+	float *frequency;
+	float *thdU[3];
+	float *thdI[3];
+	double *voltage[3];
+	double *current[3];
+	double *uiAngle[3];
+
+	metersim_energy_t (*energy)[3]; /* registers at the beginning of the simulation */
+} timeline_t;
+
+
+/* Position in the timeline */
+typedef struct {
+	size_t row;                     /* index of the next update */
+	size_t entry[TIMELINE_GROUPS];  /* index of the next entry of each group */
+} timeline_cursor_t;
+
+
+/*
+ * Reads updates.csv from `dir` and keeps a copy of the initial registers `energy`.
+ * Updates with tariff index out of `tariffCount` are skipped.
+ */
+timeline_t *timeline_load(const char *dir, uint8_t tariffCount, metersim_energy_t (*energy)[3]);
+
+
+timeline_t *timeline_acquire(timeline_t *tl);
+
+
+/* Drops a reference, frees the timeline when it was the last one */
+void timeline_release(timeline_t *tl);
+
+
+/*
+ * Moves the cursor to the next update and writes the values it changes into `upd`, which has to
+ * hold the previous update. Returns false at the end of the timeline.
+ */
+bool timeline_next(const timeline_t *tl, timeline_cursor_t *cur, metersim_update_t *upd);
+
+
+/* Places the cursor before the update with index `row`, returns -1 if it is out of the timeline */
+int timeline_seek(const timeline_t *tl, timeline_cursor_t *cur, size_t row);
+
+#endif /* TIMELINE_H */
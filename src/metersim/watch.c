@@ -0,0 +1,167 @@
+/*
+ * Watchpoints on the state of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "calculator.h"
+#include "watch.h"
+
+
+static bool evaluate(const watch_point_t *point, const metersim_state_t *state)
+{
+	switch (point->type) {
+		case METERSIM_WATCH_POWER_ABOVE:
+			return calculator_getTotalPower(state) > point->threshold;
+
+		case METERSIM_WATCH_POWER_BELOW:
+			return calculator_getTotalPower(state) < point->threshold;
+
+		case METERSIM_WATCH_TARIFF_CHANGE:
+			return state->currentTariff != point->tariff;
+
+		case METERSIM_WATCH_ENERGY_CROSS:
+			return (double)calculator_getActivePlus(state) >= point->threshold;
+
+		default:
+			return false;
+	}
+}
+
+
+void watch_init(watch_ctx_t *ctx)
+{
+	for (int id = 0; id < METERSIM_MAX_WATCHPOINTS; id++) {
+		ctx->points[id].used = false;
+	}
+}
+
+
+int watch_add(watch_ctx_t *ctx, const metersim_state_t *state, int type, double threshold, void (*callback)(int, int32_t, void *), void *callbackCtx)
+{
+	watch_point_t *point;
+
+	if (type < METERSIM_WATCH_POWER_ABOVE || type > METERSIM_WATCH_ENERGY_CROSS || isnan(threshold)) {
+		return -1;
+	}
+
+	for (int id = 0; id < METERSIM_MAX_WATCHPOINTS; id++) {
+		point = &ctx->points[id];
+		if (point->used) {
+			continue;
+		}
+
+		*point = (watch_point_t) {
+			.used = true,
+			.type = type,
+			.threshold = threshold,
+			.tariff = state->currentTariff,
+			.callback = callback,
+			.callbackCtx = callbackCtx
+		};
+		/* A condition which already holds triggers only after it stops and holds again */
+		point->active = evaluate(point, state);
+
+		return id;
+	}
+
+	return -1;
+}
+
+
+int watch_remove(watch_ctx_t *ctx, int id)
+{
+	if (id < 0 || id >= METERSIM_MAX_WATCHPOINTS || !ctx->points[id].used) {
+		return -1;
+	}
+
+	ctx->points[id].used = false;
+	return 0;
+}
+
+
+bool watch_hasPausing(watch_ctx_t *ctx)
+{
+	for (int id = 0; id < METERSIM_MAX_WATCHPOINTS; id++) {
+		if (ctx->points[id].used && ctx->points[id].callback == NULL) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+int32_t watch_getNextTime(watch_ctx_t *ctx, const metersim_state_t *state, int32_t now)
+{
+	int32_t res = METERSIM_NO_UPDATE_SCHEDULED;
+	double power = -1, dt;
+	int64_t energy = 0;
+	watch_point_t *point;
+
+	for (int id = 0; id < METERSIM_MAX_WATCHPOINTS; id++) {
+		point = &ctx->points[id];
+		if (!point->used || point->type != METERSIM_WATCH_ENERGY_CROSS || point->active) {
+			continue;
+		}
+
+		if (power < 0) {
+			power = calculator_getImportPower(state);
+			energy = calculator_getActivePlus(state);
+		}
+		if (power == 0) {
+			break;
+		}
+
+		/* Registers grow linearly between updates, rounding is caught by a check one second later */
+		dt = ceil((point->threshold - (double)energy) / power);
+		dt = dt < 1 ? 1 : dt;
+		if (dt < (double)(res - now)) {
+			res = now + (int32_t)dt;
+		}
+	}
+
+	return res;
+}
+
+
+bool watch_check(watch_ctx_t *ctx, const metersim_state_t *state, int32_t now)
+{
+	bool pause = false, active;
+	watch_point_t *point;
+
+	for (int id = 0; id < METERSIM_MAX_WATCHPOINTS; id++) {
+		point = &ctx->points[id];
+		if (!point->used) {
+			continue;
+		}
+
+		active = evaluate(point, state);
+		if (active && !point->active) {
+			if (point->callback != NULL) {
+				point->callback(id, now, point->callbackCtx);
+			}
+			else {
+				pause = true;
+			}
+		}
+
+		if (point->type == METERSIM_WATCH_TARIFF_CHANGE) {
+			/* Rearm for the next change */
+			point->tariff = state->currentTariff;
+			active = false;
+		}
+		point->active = active;
+	}
+
+	return pause;
+}
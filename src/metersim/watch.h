@@ -0,0 +1,58 @@
+/*
+ * Watchpoints on the state of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+
+
+typedef struct {
+	bool used;
+	int type;         /* METERSIM_WATCH_* */
+	double threshold;
+	bool active;      /* value of the condition at the last check */
+	uint8_t tariff;   /* tariff at the last check, for METERSIM_WATCH_TARIFF_CHANGE */
+
+	void (*callback)(int, int32_t, void *); /* NULL if the runner should pause */
+	void *callbackCtx;
+} watch_point_t;
+
+
+typedef struct {
+	watch_point_t points[METERSIM_MAX_WATCHPOINTS];
+} watch_ctx_t;
+
+
+void watch_init(watch_ctx_t *ctx);
+
+
+/* Returns id of the new watchpoint or -1. The condition is armed against the current `state`. */
+int watch_add(watch_ctx_t *ctx, const metersim_state_t *state, int type, double threshold, void (*callback)(int, int32_t, void *), void *callbackCtx);
+
+
+int watch_remove(watch_ctx_t *ctx, int id);
+
+
+/* Returns true if any watchpoint has no callback and pauses the runner */
+bool watch_hasPausing(watch_ctx_t *ctx);
+
+
+/* Returns the earliest time at which an energy crossing may happen */
+int32_t watch_getNextTime(watch_ctx_t *ctx, const metersim_state_t *state, int32_t now);
+
+
+/* Evaluates the watchpoints and calls callbacks of the triggered ones. Returns true if the runner should pause. */
+bool watch_check(watch_ctx_t *ctx, const metersim_state_t *state, int32_t now);
+
+#endif /* WATCH_H */
@@ -0,0 +1,154 @@
+/*
+ * Waveform synthesis of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+#include "waveform.h"
+#include "log.h"
+
+#define LOG_TAG "waveform : "
+
+
+static const int harmonicOrder[WAVEFORM_HARMONICS] = { 1, 3, 5, 7, 9, 11, 13 };
+
+
+static void computeTables(waveform_ctx_t *ctx, float frequency)
+{
+	const double step = 2 * M_PI * frequency / ctx->sampleRate;
+	double arg;
+
+	for (int h = 0; h < WAVEFORM_HARMONICS; h++) {
+		for (int n = 0; n < METERSIM_WAVEFORM_BLOCK; n++) {
+			arg = fmod(harmonicOrder[h] * step * n, 2 * M_PI);
+			ctx->buf->cosTable[h][n] = (float)cos(arg);
+			ctx->buf->sinTable[h][n] = (float)sin(arg);
+		}
+	}
+	ctx->tableFrequency = frequency;
+}
+
+
+/* out[n] = sum over harmonics of Re(c_h * exp(j * h * w * n)). Inner loops are plain multiply-adds over the block. */
+static void synthesize(const waveform_ctx_t *ctx, float *restrict out, double _Complex phasor, float thd, double phase)
+{
+	const double amplitude = M_SQRT2 * cabs(phasor);
+	const double angle = carg(phasor);
+	double a, theta;
+	float re, im;
+	const float *restrict c;
+	const float *restrict s;
+
+	memset(out, 0, METERSIM_WAVEFORM_BLOCK * sizeof(float));
+
+	for (int h = 0; h < WAVEFORM_HARMONICS; h++) {
+		a = amplitude * (h == 0 ? 1.0 : thd * ctx->weight[h]);
+		if (a == 0) {
+			continue;
+		}
+
+		theta = fmod(harmonicOrder[h] * (phase + angle), 2 * M_PI);
+		re = (float)(a * cos(theta));
+		im = (float)(a * sin(theta));
+		c = ctx->buf->cosTable[h];
+		s = ctx->buf->sinTable[h];
+
+		for (int n = 0; n < METERSIM_WAVEFORM_BLOCK; n++) {
+			out[n] += re * c[n] - im * s[n];
+		}
+	}
+}
+
+
+int waveform_init(waveform_ctx_t *ctx, const metersim_config_t *cfg)
+{
+	double sum = 0;
+
+	ctx->sampleRate = cfg->waveformSampleRate;
+	ctx->nextSample = 0;
+	ctx->phase = 0;
+	ctx->tableFrequency = -1;
+	ctx->buf = NULL;
+
+	for (int h = 1; h < WAVEFORM_HARMONICS; h++) {
+		sum += 1.0 / (harmonicOrder[h] * harmonicOrder[h]);
+	}
+	/* Amplitude of the harmonic of order h is proportional to 1/h, root sum of squares is 1 */
+	ctx->weight[0] = 1;
+	for (int h = 1; h < WAVEFORM_HARMONICS; h++) {
+		ctx->weight[h] = 1.0 / harmonicOrder[h] / sqrt(sum);
+	}
+
+	if (ctx->sampleRate == 0) {
+		return 0;
+	}
+
+	ctx->buf = malloc(sizeof(waveform_buffers_t));
+	if (ctx->buf == NULL) {
+		log_error("Could not allocate memory for waveform synthesis");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+void waveform_reset(waveform_ctx_t *ctx)
+{
+	ctx->nextSample = 0;
+	ctx->phase = 0;
+}
+
+
+void waveform_destroy(waveform_ctx_t *ctx)
+{
+	free(ctx->buf);
+}
+
+
+int waveform_generate(waveform_ctx_t *ctx, const metersim_state_t *state, metersim_waveform_t *ret)
+{
+	const float frequency = state->instant.frequency;
+	waveform_buffers_t *buf = ctx->buf;
+
+	if (buf == NULL) {
+		return -1;
+	}
+
+	/* Tables depend only on the frequency, which changes rarely */
+	if (frequency != ctx->tableFrequency) {
+		computeTables(ctx, frequency);
+	}
+
+	for (int i = 0; i < 3; i++) {
+		if (i < state->cfg.phaseCount) {
+			synthesize(ctx, buf->u[i], state->vector.phaseVoltage[i], state->thd.thdU[i], ctx->phase);
+			synthesize(ctx, buf->i[i], state->vector.phaseCurrent[i], state->thd.thdI[i], ctx->phase);
+		}
+		else {
+			memset(buf->u[i], 0, sizeof(buf->u[i]));
+			memset(buf->i[i], 0, sizeof(buf->i[i]));
+		}
+		ret->u[i] = buf->u[i];
+		ret->i[i] = buf->i[i];
+	}
+	ret->count = METERSIM_WAVEFORM_BLOCK;
+	ret->firstSample = ctx->nextSample;
+	ret->sampleRate = ctx->sampleRate;
+
+	ctx->nextSample += METERSIM_WAVEFORM_BLOCK;
+	ctx->phase = fmod(ctx->phase + 2 * M_PI * frequency * METERSIM_WAVEFORM_BLOCK / ctx->sampleRate, 2 * M_PI);
+
+	return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * Waveform synthesis of the SEM simulator
+ *
+ * Copyright 2023-2024 Phoenix Systems
+ * Author: Mateusz Kobak
+ *
+ * %LICENSE%
+ */
+
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <stdint.h>
+
+#include <metersim/metersim_types.h>
+#include "metersim_types_int.h"
+
+/* Harmonic orders synthesized: the fundamental and odd harmonics up to 13 */
+#define WAVEFORM_HARMONICS 7
+
+
+typedef struct {
+	/* cos(h * w * n / sampleRate) and sin(...) for the harmonics over one block, valid for `tableFrequency` */
+	float cosTable[WAVEFORM_HARMONICS][METERSIM_WAVEFORM_BLOCK];
+	float sinTable[WAVEFORM_HARMONICS][METERSIM_WAVEFORM_BLOCK];
+
+	float u[3][METERSIM_WAVEFORM_BLOCK];
+	float i[3][METERSIM_WAVEFORM_BLOCK];
+} waveform_buffers_t;
+
+
+typedef struct {
+	uint32_t sampleRate; /* (Hz) 0 if the generator is disabled */
+	uint64_t nextSample;
+	double phase; /* (rad) angle of the fundamental at the next sample */
+	double weight[WAVEFORM_HARMONICS]; /* relative amplitudes of the harmonics */
+	float tableFrequency;
+
+	waveform_buffers_t *buf; /* NULL if the generator is disabled */
+} waveform_ctx_t;
+
+
+/* Buffers are allocated only if `waveformSampleRate` is set */
+int waveform_init(waveform_ctx_t *ctx, const metersim_config_t *cfg);
+
+
+/* Restarts the sample stream, keeps the allocated buffers */
+void waveform_reset(waveform_ctx_t *ctx);
+
+
+void waveform_destroy(waveform_ctx_t *ctx);
+
+
+/* Synthesizes the next block from the current state. Returns -1 if the generator is disabled. */
+int waveform_generate(waveform_ctx_t *ctx, const metersim_state_t *state, metersim_waveform_t *ret);
+
+#endif /* WAVEFORM_H */
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <limits.h>
 
 #include <mm_api.h>
 #include <metersim/metersim.h>
@@ -238,6 +239,54 @@ int mme_getMeterConstant(mm_ctx_T *ctx, unsigned int *ret)
 }
 
 
+static void convertInstant(struct mme_dataInstant *dst, const metersim_instant_t *src)
+{
+	for (int i = 0; i < 3; i++) {
+		dst->i[i] = (float)src->current[i];
+		dst->u[i] = (float)src->voltage[i];
+		dst->uiAngle[i] = (float)src->uiAngle[i];
+		if (i < 2) {
+			dst->ppAngle[i] = (float)src->ppAngle[i];
+		}
+	}
+	dst->in = (float)src->currentNeutral;
+}
+
+
+static void convertEnergy(struct mme_dataEnergy *dst, const metersim_energy_t *src)
+{
+	dst->activeMinus = src->activeMinus.value;
+	dst->activePlus = src->activePlus.value;
+	dst->apparentMinus = src->apparentMinus.value;
+	dst->apparentPlus = src->apparentPlus.value;
+	for (int j = 0; j < 4; j++) {
+		dst->reactive[j] = src->reactive[j].value;
+	}
+}
+
+
+static void convertPower(struct mme_dataPower *dst, const metersim_power_t *src)
+{
+	for (int i = 0; i < 3; i++) {
+		dst->p[i] = (float)src->truePower[i];
+		dst->q[i] = (float)src->reactivePower[i];
+		dst->s[i] = (float)src->apparentPower[i];
+		dst->phi[i] = (float)src->phi[i];
+	}
+}
+
+
+static void convertVector(struct mme_dataVector *dst, const metersim_vector_t *src)
+{
+	for (int i = 0; i < 3; i++) {
+		dst->s[i] = (float _Complex)src->complexPower[i];
+		dst->u[i] = (float _Complex)src->phaseVoltage[i];
+		dst->i[i] = (float _Complex)src->phaseCurrent[i];
+	}
+	dst->in = (float _Complex)src->complexNeutral;
+}
+
+
 int mme_getInstant(mm_ctx_T *ctx, struct mme_dataInstant *ret)
 {
 	int status;
@@ -249,15 +298,7 @@ int mme_getInstant(mm_ctx_T *ctx, struct mme_dataInstant *ret)
 	metersim_instant_t instant;
 	metersim_getInstant(ctx->msCtx, &instant);
 
-	for (int i = 0; i < 3; i++) {
-		ret->i[i] = (float)instant.current[i];
-		ret->u[i] = (float)instant.voltage[i];
-		ret->uiAngle[i] = (float)instant.uiAngle[i];
-		if (i < 2) {
-			ret->ppAngle[i] = (float)instant.ppAngle[i];
-		}
-	}
-	ret->in = (float)instant.currentNeutral;
+	convertInstant(ret, &instant);
 	return MM_SUCCESS;
 }
 
@@ -273,16 +314,7 @@ int mme_getEnergyTotal(mm_ctx_T *ctx, struct mme_dataEnergy *ret)
 	metersim_energy_t energy;
 	metersim_getEnergyTotal(ctx->msCtx, &energy);
 
-	for (int i = 0; i < 3; i++) {
-		ret->activeMinus = energy.activeMinus.value;
-		ret->activePlus = energy.activePlus.value;
-		ret->apparentMinus = energy.apparentMinus.value;
-		ret->apparentPlus = energy.apparentPlus.value;
-		for (int j = 0; j < 4; j++) {
-			ret->reactive[j] = energy.reactive[j].value;
-		}
-	}
-
+	convertEnergy(ret, &energy);
 	return MM_SUCCESS;
 }
 
@@ -314,6 +346,146 @@ int mme_getEnergyTariff(mm_ctx_T *ctx, struct mme_dataEnergy ret[3], int idxTari
 }
 
 
+int mme_getDemand(mm_ctx_T *ctx, struct mme_dataDemand *ret, int idxTariff)
+{
+	int status;
+	int64_t startUtc;
+	status = checkStatus(ctx);
+	if (status != MM_SUCCESS) {
+		return status;
+	}
+
+	metersim_demand_t demand;
+	if (metersim_getDemand(ctx->msCtx, &demand, idxTariff) != 0) {
+		return MM_ERROR;
+	}
+
+	metersim_getStartTimeUTC(ctx->msCtx, &startUtc);
+
+	for (int i = 0; i < 2; i++) {
+		ret->last[i] = (float)demand.last[i];
+		ret->max[i] = (float)demand.max[i];
+		ret->maxTime[i] = startUtc + demand.maxTime[i];
+	}
+	return MM_SUCCESS;
+}
+
+
+int mme_getLoadProfile(mm_ctx_T *ctx, int64_t fromUtc, int64_t toUtc, struct mme_dataProfile *buf, size_t n)
+{
+	int status;
+	int64_t startUtc;
+	int32_t from, to;
+	size_t count = 0, chunk;
+	metersim_profileEntry_t entries[16];
+	status = checkStatus(ctx);
+	if (status != MM_SUCCESS) {
+		return status;
+	}
+
+	metersim_getStartTimeUTC(ctx->msCtx, &startUtc);
+
+	if (toUtc < startUtc || fromUtc > toUtc) {
+		return 0;
+	}
+	from = fromUtc <= startUtc ? 0 : (int32_t)(fromUtc - startUtc);
+	to = toUtc - startUtc > INT32_MAX ? INT32_MAX : (int32_t)(toUtc - startUtc);
+
+	/* Copy in chunks through a small buffer to avoid allocation */
+	while (count < n) {
+		chunk = metersim_getLoadProfile(ctx->msCtx, from, to, entries, n - count < 16 ? n - count : 16);
+		for (size_t k = 0; k < chunk; k++) {
+			struct mme_dataProfile *dst = &buf[count + k];
+			dst->timestamp = startUtc + entries[k].timestamp;
+			convertEnergy(&dst->energy, &entries[k].energy);
+			dst->frequency = entries[k].frequency;
+			for (int j = 0; j < 3; j++) {
+				dst->u[j] = (float)entries[k].voltage[j];
+				dst->i[j] = (float)entries[k].current[j];
+			}
+		}
+		count += chunk;
+		if (chunk < 16 || entries[chunk - 1].timestamp >= to) {
+			break;
+		}
+		from = entries[chunk - 1].timestamp + 1;
+	}
+
+	return (int)count;
+}
+
+
+static void convertPqAggregate(struct mme_dataPqAggregate *dst, const metersim_pqAggregate_t *src)
+{
+	dst->min = (float)src->min;
+	dst->max = (float)src->max;
+	dst->mean = (float)src->mean;
+	dst->p95 = (float)src->p95;
+}
+
+
+int mme_getPqStats(mm_ctx_T *ctx, struct mme_dataPqStats *ret, int window)
+{
+	int status;
+	int64_t startUtc;
+	status = checkStatus(ctx);
+	if (status != MM_SUCCESS) {
+		return status;
+	}
+
+	metersim_pqStats_t stats;
+	if (metersim_getPqStats(ctx->msCtx, &stats, window) != 0) {
+		return MM_ERROR;
+	}
+
+	metersim_getStartTimeUTC(ctx->msCtx, &startUtc);
+
+	ret->start = startUtc + stats.start;
+	ret->end = startUtc + stats.end;
+	convertPqAggregate(&ret->frequency, &stats.frequency);
+	for (int i = 0; i < 3; i++) {
+		convertPqAggregate(&ret->u[i], &stats.voltage[i]);
+		convertPqAggregate(&ret->thdU[i], &stats.thdU[i]);
+		convertPqAggregate(&ret->thdI[i], &stats.thdI[i]);
+	}
+	return MM_SUCCESS;
+}
+
+
+int mme_getPqEvents(mm_ctx_T *ctx, struct mme_dataPqEvent *buf, size_t n)
+{
+	int status;
+	int64_t startUtc;
+	size_t count = 0, chunk;
+	metersim_pqEvent_t events[16];
+	status = checkStatus(ctx);
+	if (status != MM_SUCCESS) {
+		return status;
+	}
+
+	metersim_getStartTimeUTC(ctx->msCtx, &startUtc);
+
+	/* Copy in chunks through a small buffer to avoid allocation */
+	while (count < n) {
+		chunk = metersim_readPqEvents(ctx->msCtx, events, n - count < 16 ? n - count : 16);
+		for (size_t k = 0; k < chunk; k++) {
+			struct mme_dataPqEvent *dst = &buf[count + k];
+			dst->type = events[k].type;
+			dst->phase = events[k].phase;
+			dst->start = startUtc + events[k].start;
+			dst->end = events[k].end == METERSIM_PQ_EVENT_ONGOING ? MME_PQ_EVENT_ONGOING : startUtc + events[k].end;
+			dst->extreme = (float)events[k].extreme;
+		}
+		count += chunk;
+		if (chunk < 16) {
+			break;
+		}
+	}
+
+	return (int)count;
+}
+
+
 int mme_getPower(mm_ctx_T *ctx, struct mme_dataPower *ret)
 {
 	int status;
@@ -325,12 +497,7 @@ int mme_getPower(mm_ctx_T *ctx, struct mme_dataPower *ret)
 	metersim_power_t power;
 	metersim_getPower(ctx->msCtx, &power);
 
-	for (int i = 0; i < 3; i++) {
-		ret->p[i] = (float)power.truePower[i];
-		ret->q[i] = (float)power.reactivePower[i];
-		ret->s[i] = (float)power.apparentPower[i];
-		ret->phi[i] = (float)power.phi[i];
-	}
+	convertPower(ret, &power);
 	return MM_SUCCESS;
 }
 
@@ -346,12 +513,7 @@ int mme_getVector(mm_ctx_T *ctx, struct mme_dataVector *ret)
 	metersim_vector_t vector;
 	metersim_getVector(ctx->msCtx, &vector);
 
-	for (int i = 0; i < 3; i++) {
-		ret->s[i] = (float _Complex)vector.complexPower[i];
-		ret->u[i] = (float _Complex)vector.phaseVoltage[i];
-		ret->i[i] = (float _Complex)vector.phaseCurrent[i];
-	}
-	ret->in = (float _Complex)vector.complexNeutral;
+	convertVector(ret, &vector);
 	return MM_SUCCESS;
 }
 
@@ -390,3 +552,29 @@ int mme_getThdU(mm_ctx_T *ctx, float retThdU[3])
 	}
 	return MM_SUCCESS;
 }
+
+
+int mme_getAll(mm_ctx_T *ctx, struct mme_dataAll *ret)
+{
+	int status;
+	status = checkStatus(ctx);
+	if (status != MM_SUCCESS) {
+		return status;
+	}
+
+	metersim_snapshot_t snap;
+	metersim_getSnapshot(ctx->msCtx, METERSIM_SNAPSHOT_ALL, &snap);
+
+	ret->timestamp = snap.timeUtc;
+	ret->tariff = snap.currentTariff;
+	ret->frequency = snap.instant.frequency;
+	convertInstant(&ret->instant, &snap.instant);
+	convertPower(&ret->power, &snap.power);
+	convertVector(&ret->vector, &snap.vector);
+	convertEnergy(&ret->energy, &snap.energy);
+	for (int i = 0; i < 3; i++) {
+		ret->thdU[i] = snap.thd.thdU[i];
+		ret->thdI[i] = snap.thd.thdI[i];
+	}
+	return MM_SUCCESS;
+}
@@ -60,15 +60,24 @@ static metersim_update_t upd[3] = {
 static calculator_bias_t bias = { 0 };
 
 
-void setUp(void)
+static void initScenario(uint8_t phaseCount)
 {
+	metersim_scenario_t scenario = {
+		.cfg = {
+			.tariffCount = 1,
+			.phaseCount = phaseCount,
+		},
+		.energy = calloc(1, sizeof(metersim_energy_t[3])),
+	};
+
 	common.state = (metersim_state_t) { 0 };
-	common.state.energy = calloc(1, sizeof(metersim_energy_t[3]));
+	calculator_initScenario(&common.state, &scenario);
+}
 
-	common.state.cfg = (metersim_config_t) {
-		.tariffCount = 1,
-		.phaseCount = 3,
-	};
+
+void setUp(void)
+{
+	initScenario(3);
 }
 
 
@@ -360,11 +369,34 @@ void testMaxValues(void)
 }
 
 
+void testSinglePhase(void)
+{
+	metersim_energy_t total;
+
+	free(common.state.energy);
+	initScenario(1);
+
+	calculator_handleUpdate(&common.state, &upd[0], &bias);
+	TEST_DOUBLE_WITH_EPSILON(11000, common.state.power.truePower[0], 1e-6);
+	TEST_DOUBLE_WITH_EPSILON(0, common.state.power.apparentPower[1], 0);
+
+	calculator_accumulateEnergy(&common.state, 3);
+	TEST_ASSERT_EQUAL_INT64(33000, common.state.energy[0][0].activePlus.value);
+	TEST_ASSERT_EQUAL_INT64(0, common.state.energy[0][1].activePlus.value);
+	TEST_ASSERT_EQUAL_INT64(0, common.state.energy[0][2].activePlus.value);
+
+	calculator_getEnergyTotal(&common.state, &total);
+	TEST_ASSERT_EQUAL_INT64(33000, total.activePlus.value);
+	TEST_ASSERT_EQUAL_INT64(33000, total.apparentPlus.value);
+}
+
+
 int main(void)
 {
 	RUN_TEST(testPower);
 	RUN_TEST(testEnergy);
 	RUN_TEST(testMaxValues);
+	RUN_TEST(testSinglePhase);
 
 	return 0;
 }
@@ -76,6 +76,17 @@ static void compareScenarios(metersim_scenario_t *expected, metersim_scenario_t
 	TEST_ASSERT_EQUAL_UINT8(expected->cfg.phaseCount, actual->cfg.phaseCount);
 	TEST_ASSERT_EQUAL_UINT32(expected->cfg.meterConstant, actual->cfg.meterConstant);
 	TEST_ASSERT_EQUAL_INT(expected->cfg.speedup, actual->cfg.speedup);
+	TEST_ASSERT_EQUAL_INT32(expected->cfg.demandPeriod, actual->cfg.demandPeriod);
+	TEST_ASSERT_EQUAL_UINT8(expected->cfg.demandSubperiods, actual->cfg.demandSubperiods);
+	TEST_ASSERT_EQUAL_DOUBLE(expected->cfg.pq.nominalVoltage, actual->cfg.pq.nominalVoltage);
+	TEST_ASSERT_EQUAL_DOUBLE(expected->cfg.pq.sagThreshold, actual->cfg.pq.sagThreshold);
+	TEST_ASSERT_EQUAL_DOUBLE(expected->cfg.pq.thdUThreshold, actual->cfg.pq.thdUThreshold);
+#ifdef METERSIM_ERROR_MODEL
+	TEST_ASSERT_EQUAL_UINT64(expected->cfg.error.seed, actual->cfg.error.seed);
+	TEST_ASSERT_EQUAL_DOUBLE(expected->cfg.error.currentGain, actual->cfg.error.currentGain);
+	TEST_ASSERT_EQUAL_DOUBLE(expected->cfg.error.phaseError, actual->cfg.error.phaseError);
+	TEST_ASSERT_EQUAL_DOUBLE(expected->cfg.error.voltageGain, actual->cfg.error.voltageGain);
+#endif
 
 	if (expected->cfg.tariffCount != actual->cfg.tariffCount) {
 		return;
@@ -120,6 +131,20 @@ static void testScenario(void)
 			.phaseCount = 2,
 			.meterConstant = 7200,
 			.speedup = 4,
+			.demandPeriod = 1800,
+			.demandSubperiods = 3,
+			.pq = {
+				.nominalVoltage = 230,
+				.sagThreshold = 0.85,
+				.thdUThreshold = 0.08,
+			},
+#ifdef METERSIM_ERROR_MODEL
+			.error = {
+				.seed = 42,
+				.currentGain = 0.01,
+				.phaseError = 0.5,
+			},
+#endif
 		},
 		.energy = scenario1Energy,
 	};
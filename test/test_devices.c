@@ -94,6 +94,25 @@ static void cb3(metersim_infoForDevice_t *info, metersim_deviceResponse_t *res,
 }
 
 
+/* Device4 recording the moments of its callbacks */
+typedef struct {
+	int32_t calls[8];
+	int count;
+} ctx4_t;
+
+
+static void cb4(metersim_infoForDevice_t *info, metersim_deviceResponse_t *res, void *ctx)
+{
+	ctx4_t *ctx4 = (ctx4_t *)ctx;
+
+	if (ctx4->count < 8) {
+		ctx4->calls[ctx4->count++] = info->now;
+	}
+	res->current[0] = 1;
+	res->nextUpdateTime = METERSIM_NO_UPDATE_SCHEDULED;
+}
+
+
 static void compareCurrent(double *expected, double *actual, char *msg)
 {
 	TEST_ASSERT_EQUAL_DOUBLE_MESSAGE(expected[0], actual[0], msg);
@@ -208,6 +227,31 @@ void testDestroyingDevices(void)
 }
 
 
+void testVoltageOnlyNotification(void)
+{
+	const int32_t expected[] = { 0, 60, 120, 180 };
+	ctx4_t cbCtx = { .count = 0 };
+	metersim_instant_t instant;
+	int tariff;
+
+	metersim_newDevice(common.ctx, &cb4, &cbCtx);
+
+	/* Current of the device is kept across the tariff-only update at 10 */
+	metersim_stepForward(common.ctx, 30);
+	metersim_getInstant(common.ctx, &instant);
+	TEST_ASSERT_EQUAL_DOUBLE(11, instant.current[0]);
+	metersim_getTariffCurrent(common.ctx, &tariff);
+	TEST_ASSERT_EQUAL_INT(4, tariff);
+
+	/* The device is woken only by the updates changing the voltage */
+	metersim_stepForward(common.ctx, 170);
+	TEST_ASSERT_EQUAL_INT(4, cbCtx.count);
+	for (int i = 0; i < 4; i++) {
+		TEST_ASSERT_EQUAL_INT32(expected[i], cbCtx.calls[i]);
+	}
+}
+
+
 int main(int argc, char **args)
 {
 	if (argc < 2) {
@@ -221,4 +265,5 @@ int main(int argc, char **args)
 	RUN_TEST(testChangingCurrent);
 	RUN_TEST(testDynamicSwitching);
 	RUN_TEST(testDestroyingDevices);
+	RUN_TEST(testVoltageOnlyNotification);
 }
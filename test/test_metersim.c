@@ -12,7 +12,10 @@
 #include <math.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <time.h>
+#include <pthread.h>
+#include <stdbool.h>
 
 #include <metersim/metersim_types.h>
 #include <metersim/metersim.h>
@@ -30,6 +33,7 @@
 static struct {
 	metersim_ctx_t *ctx;
 	char inputPath[1024];
+	char baselinePath[1024];
 } common;
 
 
@@ -85,14 +89,721 @@ void testStepForward(void)
 }
 
 
+void testStepAndSample(void)
+{
+	metersim_sample_t samples[4];
+	metersim_energy_t total;
+	metersim_instant_t instant;
+	int32_t uptime;
+
+	/* Buffer too small for the requested number of samples */
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_stepAndSample(common.ctx, 22, 5, METERSIM_SAMPLE_ALL, samples, 3));
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_stepAndSample(common.ctx, 22, 0, METERSIM_SAMPLE_ALL, samples, 4));
+
+	TEST_ASSERT_EQUAL_INT(4, metersim_stepAndSample(common.ctx, 22, 5, METERSIM_SAMPLE_ALL, samples, 4));
+
+	/* Whole period has been simulated, including the remainder after the last sample */
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(22, uptime);
+
+	for (int i = 0; i < 4; i++) {
+		TEST_ASSERT_EQUAL_INT32(5 * (i + 1), samples[i].timestamp);
+		TEST_ASSERT_EQUAL_DOUBLE(210, samples[i].instant.voltage[0]);
+		TEST_ASSERT_EQUAL_DOUBLE(10, samples[i].instant.current[0]);
+		TEST_ASSERT_EQUAL_DOUBLE(2100, samples[i].power.truePower[0]);
+	}
+
+	/* Sample at timestamp 20 should agree with the energy getter at the same moment */
+	metersim_ctx_t *ref = metersim_init(common.inputPath);
+	metersim_stepForward(ref, 20);
+	metersim_getEnergyTotal(ref, &total);
+	metersim_getInstant(ref, &instant);
+	metersim_free(ref);
+
+	TEST_ASSERT_EQUAL_INT64(total.activePlus.value, samples[3].energy.activePlus.value);
+	TEST_ASSERT_EQUAL_INT64(total.activeMinus.value, samples[3].energy.activeMinus.value);
+	TEST_ASSERT_EQUAL_INT64(total.reactive[1].value, samples[3].energy.reactive[1].value);
+	TEST_ASSERT_EQUAL_INT64(total.apparentPlus.value, samples[3].energy.apparentPlus.value);
+	TEST_ASSERT_EQUAL_DOUBLE(instant.uiAngle[1], samples[3].instant.uiAngle[1]);
+}
+
+
+void testDemand(void)
+{
+	metersim_demand_t demand;
+	metersim_power_t power;
+	double expectedImport = 0, expectedExport = 0;
+
+	/* No window has been completed yet */
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_getDemand(common.ctx, &demand, 0));
+	TEST_ASSERT_EQUAL_DOUBLE(0, demand.last[METERSIM_DEMAND_IMPORT]);
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_getDemand(common.ctx, &demand, 5));
+
+	/* Power is constant from timestamp 180, so the second 900 s window has constant demand */
+	metersim_stepForward(common.ctx, 1800);
+	metersim_getPower(common.ctx, &power);
+	for (int i = 0; i < 3; i++) {
+		if (power.truePower[i] < 0) {
+			expectedExport -= power.truePower[i];
+		}
+		else {
+			expectedImport += power.truePower[i];
+		}
+	}
+
+	metersim_getDemand(common.ctx, &demand, 0);
+	TEST_ASSERT_DOUBLE_WITHIN(1e-6, expectedImport, demand.last[METERSIM_DEMAND_IMPORT]);
+	TEST_ASSERT_DOUBLE_WITHIN(1e-6, expectedExport, demand.last[METERSIM_DEMAND_EXPORT]);
+	TEST_ASSERT(demand.max[METERSIM_DEMAND_IMPORT] >= demand.last[METERSIM_DEMAND_IMPORT]);
+	TEST_ASSERT(demand.maxTime[METERSIM_DEMAND_IMPORT] == 900 || demand.maxTime[METERSIM_DEMAND_IMPORT] == 1800);
+
+	/* Windows ended on tariff 0 only */
+	metersim_getDemand(common.ctx, &demand, 4);
+	TEST_ASSERT_EQUAL_DOUBLE(0, demand.max[METERSIM_DEMAND_IMPORT]);
+}
+
+
+void testLoadProfile(void)
+{
+	metersim_profileEntry_t entries[8];
+	metersim_energy_t total;
+
+	TEST_ASSERT_EQUAL_INT(0, metersim_getLoadProfile(common.ctx, 0, 1000, entries, 8));
+
+	metersim_stepForward(common.ctx, 300);
+	metersim_getEnergyTotal(common.ctx, &total);
+
+	/* Capacity of the profile is 4 entries, so the one captured at timestamp 60 is overwritten */
+	TEST_ASSERT_EQUAL_INT(4, metersim_getLoadProfile(common.ctx, 0, 1000, entries, 8));
+	TEST_ASSERT_EQUAL_INT32(120, entries[0].timestamp);
+	TEST_ASSERT_EQUAL_INT32(300, entries[3].timestamp);
+
+	/* Averages over [60, 120) and [120, 180) */
+	TEST_ASSERT_EQUAL_DOUBLE(240, entries[0].voltage[0]);
+	TEST_ASSERT_EQUAL_DOUBLE(270, entries[1].voltage[0]);
+	TEST_ASSERT_EQUAL_FLOAT(50, entries[1].frequency);
+	TEST_ASSERT_EQUAL_INT64(total.activePlus.value, entries[3].energy.activePlus.value);
+	TEST_ASSERT_EQUAL_INT64(total.reactive[1].value, entries[3].energy.reactive[1].value);
+
+	/* Range queries */
+	TEST_ASSERT_EQUAL_INT(2, metersim_getLoadProfile(common.ctx, 130, 240, entries, 8));
+	TEST_ASSERT_EQUAL_INT32(180, entries[0].timestamp);
+	TEST_ASSERT_EQUAL_INT32(240, entries[1].timestamp);
+	TEST_ASSERT_EQUAL_INT(1, metersim_getLoadProfile(common.ctx, 0, 1000, entries, 1));
+	TEST_ASSERT_EQUAL_INT32(120, entries[0].timestamp);
+}
+
+
+void testLoadProfileState(void)
+{
+	const char *path = "test_metersim_state.bin";
+	metersim_ctx_t *restored;
+	metersim_profileEntry_t entries[8];
+
+	metersim_stepForward(common.ctx, 130);
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_saveState(common.ctx, path));
+
+	restored = metersim_loadState(common.inputPath, path);
+	TEST_ASSERT_NOT_NULL(restored);
+	TEST_ASSERT_EQUAL_INT(2, metersim_getLoadProfile(restored, 0, 1000, entries, 8));
+	TEST_ASSERT_EQUAL_INT32(120, entries[1].timestamp);
+	metersim_free(restored);
+
+	/* The baseline scenario has no load profile, so the state can not be restored into it */
+	TEST_ASSERT_NULL(metersim_loadState(common.baselinePath, path));
+
+	remove(path);
+}
+
+
+void testPqEvents(void)
+{
+	metersim_pqEvent_t events[8];
+
+	/* Events detected at timestamp 0 */
+	TEST_ASSERT_EQUAL_INT(2, metersim_readPqEvents(common.ctx, events, 8));
+	TEST_ASSERT_EQUAL_UINT8(METERSIM_PQ_SAG, events[0].type);
+	TEST_ASSERT_EQUAL_INT8(0, events[0].phase);
+	TEST_ASSERT_EQUAL_INT32(METERSIM_PQ_EVENT_ONGOING, events[0].end);
+	TEST_ASSERT_EQUAL_UINT8(METERSIM_PQ_THD_U, events[1].type);
+	TEST_ASSERT_EQUAL_INT8(2, events[1].phase);
+
+	metersim_stepForward(common.ctx, 200);
+
+	TEST_ASSERT_EQUAL_INT(2, metersim_readPqEvents(common.ctx, events, 2));
+	TEST_ASSERT_EQUAL_UINT8(METERSIM_PQ_SAG, events[0].type);
+	TEST_ASSERT_EQUAL_INT32(0, events[0].start);
+	TEST_ASSERT_EQUAL_INT32(60, events[0].end);
+	TEST_ASSERT_EQUAL_DOUBLE(210, events[0].extreme);
+	TEST_ASSERT_EQUAL_UINT8(METERSIM_PQ_SWELL, events[1].type);
+	TEST_ASSERT_EQUAL_INT8(1, events[1].phase);
+	TEST_ASSERT_EQUAL_INT32(120, events[1].start);
+
+	TEST_ASSERT_EQUAL_INT(2, metersim_readPqEvents(common.ctx, events, 8));
+	TEST_ASSERT_EQUAL_INT8(2, events[0].phase);
+	TEST_ASSERT_EQUAL_INT8(0, events[1].phase);
+	TEST_ASSERT_EQUAL_INT32(180, events[1].start);
+	TEST_ASSERT_EQUAL_INT(0, metersim_readPqEvents(common.ctx, events, 8));
+}
+
+
+void testPqStats(void)
+{
+	metersim_pqStats_t stats;
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_getPqStats(common.ctx, &stats, METERSIM_PQ_WINDOW_COUNT));
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_getPqStats(common.ctx, &stats, METERSIM_PQ_WINDOW_10MIN));
+	TEST_ASSERT_EQUAL_INT32(0, stats.end);
+
+	metersim_stepForward(common.ctx, 700);
+	metersim_getPqStats(common.ctx, &stats, METERSIM_PQ_WINDOW_10MIN);
+	TEST_ASSERT_EQUAL_INT32(0, stats.start);
+	TEST_ASSERT_EQUAL_INT32(600, stats.end);
+
+	/* Voltage on phase 0 is 210, 240, 270 for 60 s each and 300 afterwards */
+	TEST_ASSERT_EQUAL_DOUBLE(210, stats.voltage[0].min);
+	TEST_ASSERT_EQUAL_DOUBLE(300, stats.voltage[0].max);
+	TEST_ASSERT_EQUAL_DOUBLE(282, stats.voltage[0].mean);
+	TEST_ASSERT_EQUAL_DOUBLE(300, stats.voltage[0].p95);
+	TEST_ASSERT_EQUAL_DOUBLE(50, stats.frequency.mean);
+
+	/* No 2-hour window was completed yet */
+	metersim_getPqStats(common.ctx, &stats, METERSIM_PQ_WINDOW_2H);
+	TEST_ASSERT_EQUAL_INT32(0, stats.end);
+}
+
+
+void testWaveform(void)
+{
+	metersim_waveform_t wf;
+	double sum = 0;
+	float first;
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_readWaveform(common.ctx, &wf));
+	TEST_ASSERT_EQUAL_UINT32(METERSIM_WAVEFORM_BLOCK, wf.count);
+	TEST_ASSERT_EQUAL_UINT32(6400, wf.sampleRate);
+	TEST_ASSERT_EQUAL_UINT64(0, wf.firstSample);
+	first = wf.u[0][0];
+
+	/* A block covers 2 periods at 50 Hz, so RMS includes the harmonics exactly */
+	for (uint32_t n = 0; n < wf.count; n++) {
+		sum += (double)wf.u[0][n] * wf.u[0][n];
+	}
+	TEST_ASSERT_DOUBLE_WITHIN(0.01, 210 * sqrt(1 + 0.5 * 0.5), sqrt(sum / wf.count));
+
+	/* Phase is continuous between blocks */
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_readWaveform(common.ctx, &wf));
+	TEST_ASSERT_EQUAL_UINT64(METERSIM_WAVEFORM_BLOCK, wf.firstSample);
+	TEST_ASSERT_FLOAT_WITHIN(0.01, first, wf.u[0][0]);
+}
+
+
+void testPulses(void)
+{
+	metersim_pulse_t pulses[64];
+	metersim_power_t power;
+	double pPlus = 0;
+	size_t n;
+	int count = 0;
+
+	metersim_getPower(common.ctx, &power);
+	for (int i = 0; i < 3; i++) {
+		if (power.truePower[i] > 0) {
+			pPlus += power.truePower[i];
+		}
+	}
+
+	metersim_stepForward(common.ctx, 10);
+	n = metersim_readPulses(common.ctx, pulses, 64);
+	TEST_ASSERT_GREATER_THAN_UINT32(0, n);
+
+	for (size_t k = 0; k < n; k++) {
+		if (k > 0) {
+			TEST_ASSERT_TRUE(pulses[k - 1].timestamp <= pulses[k].timestamp);
+		}
+		if (pulses[k].channel == METERSIM_PULSE_ACTIVE_PLUS) {
+			count++;
+			/* Pulse every 3600 Ws */
+			TEST_ASSERT_DOUBLE_WITHIN(1e-9, count * 3600 / pPlus, pulses[k].timestamp);
+		}
+	}
+	TEST_ASSERT_EQUAL_INT((int)(pPlus * 10 / 3600), count);
+	TEST_ASSERT_EQUAL_INT(0, metersim_readPulses(common.ctx, pulses, 64));
+}
+
+
+void testHistory(void)
+{
+	metersim_historyPoint_t points[8];
+	const int32_t voltageTimes[] = { 0, 60, 120, 180 };
+	const double voltages[] = { 210, 240, 270, 300 };
+
+	metersim_stepForward(common.ctx, 200);
+
+	/* Only changes are recorded */
+	TEST_ASSERT_EQUAL_INT(4, metersim_queryHistory(common.ctx, METERSIM_HISTORY_VOLTAGE + 0, 0, 200, points, 8));
+	for (int i = 0; i < 4; i++) {
+		TEST_ASSERT_EQUAL_INT32(voltageTimes[i], points[i].timestamp);
+		TEST_ASSERT_EQUAL_DOUBLE(voltages[i], points[i].value);
+	}
+
+	TEST_ASSERT_EQUAL_INT(3, metersim_queryHistory(common.ctx, METERSIM_HISTORY_TARIFF, 0, 200, points, 8));
+	TEST_ASSERT_EQUAL_INT32(10, points[1].timestamp);
+	TEST_ASSERT_EQUAL_DOUBLE(4, points[1].value);
+	TEST_ASSERT_EQUAL_DOUBLE(0, points[2].value);
+
+	/* Range and capacity of the buffer are respected */
+	TEST_ASSERT_EQUAL_INT(2, metersim_queryHistory(common.ctx, METERSIM_HISTORY_VOLTAGE + 0, 60, 120, points, 8));
+	TEST_ASSERT_EQUAL_INT32(60, points[0].timestamp);
+	TEST_ASSERT_EQUAL_INT(1, metersim_queryHistory(common.ctx, METERSIM_HISTORY_VOLTAGE + 0, 0, 200, points, 1));
+	TEST_ASSERT_EQUAL_INT(0, metersim_queryHistory(common.ctx, METERSIM_HISTORY_VOLTAGE + 0, 190, 200, points, 8));
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_queryHistory(common.ctx, METERSIM_HISTORY_FIELDS, 0, 200, points, 8));
+}
+
+
+void testSaveState(void)
+{
+	const char *path = "test_metersim_state.bin";
+	metersim_ctx_t *restored;
+	metersim_energy_t expected, actual;
+	metersim_instant_t instant;
+	int32_t uptime;
+	int tariff;
+
+	metersim_stepForward(common.ctx, 70);
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_saveState(common.ctx, path));
+
+	restored = metersim_loadState(common.inputPath, path);
+	TEST_ASSERT_NOT_NULL(restored);
+
+	metersim_getUptime(restored, &uptime);
+	TEST_ASSERT_EQUAL_INT32(70, uptime);
+
+	/* Both simulators continue identically, including updates read after the restored position */
+	metersim_stepForward(common.ctx, 200);
+	metersim_stepForward(restored, 200);
+
+	metersim_getEnergyTotal(common.ctx, &expected);
+	metersim_getEnergyTotal(restored, &actual);
+	TEST_ASSERT_EQUAL_INT64(expected.activePlus.value, actual.activePlus.value);
+	TEST_ASSERT_EQUAL_INT64(expected.reactive[0].value, actual.reactive[0].value);
+
+	metersim_getInstant(restored, &instant);
+	TEST_ASSERT_EQUAL_DOUBLE(300, instant.voltage[0]);
+	metersim_getTariffCurrent(restored, &tariff);
+	TEST_ASSERT_EQUAL_INT(0, tariff);
+
+	metersim_free(restored);
+	remove(path);
+
+	TEST_ASSERT_NULL(metersim_loadState(common.inputPath, path));
+}
+
+
+void testClone(void)
+{
+	metersim_ctx_t *clone;
+	metersim_energy_t expected, actual;
+	metersim_deadband_t deadband = { 0 };
+	int32_t uptime;
+	int id, fds[2];
+
+	metersim_stepForward(common.ctx, 70);
+	id = metersim_addWatchpoint(common.ctx, METERSIM_WATCH_TARIFF_CHANGE, 0, NULL, NULL);
+	TEST_ASSERT_TRUE(id >= 0);
+
+	clone = metersim_clone(common.ctx);
+	TEST_ASSERT_NOT_NULL(clone);
+
+	metersim_getUptime(clone, &uptime);
+	TEST_ASSERT_EQUAL_INT32(70, uptime);
+
+	/* Watchpoints stay with the original */
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_removeWatchpoint(clone, id));
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_removeWatchpoint(common.ctx, id));
+
+	/* So do subscriptions */
+	TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	id = metersim_subscribeFd(common.ctx, METERSIM_NOTIFY_TARIFF, &deadband, fds[1]);
+	TEST_ASSERT_TRUE(id >= 0);
+	metersim_free(clone);
+	clone = metersim_clone(common.ctx);
+	TEST_ASSERT_NOT_NULL(clone);
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_unsubscribe(clone, id));
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_unsubscribe(common.ctx, id));
+	close(fds[0]);
+	close(fds[1]);
+
+	/* The clone follows the same updates as the original */
+	metersim_stepForward(common.ctx, 200);
+	metersim_stepForward(clone, 200);
+
+	metersim_getEnergyTotal(common.ctx, &expected);
+	metersim_getEnergyTotal(clone, &actual);
+	TEST_ASSERT_EQUAL_INT64(expected.activePlus.value, actual.activePlus.value);
+	TEST_ASSERT_EQUAL_INT64(expected.reactive[0].value, actual.reactive[0].value);
+
+	/* Registers of the clone are not shared with the original */
+	metersim_stepForward(clone, 100);
+	metersim_getEnergyTotal(common.ctx, &actual);
+	TEST_ASSERT_EQUAL_INT64(expected.activePlus.value, actual.activePlus.value);
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(270, uptime);
+
+	metersim_free(clone);
+
+	/* The original still works after the clone is freed */
+	metersim_stepForward(common.ctx, 100);
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(370, uptime);
+}
+
+
+void testReset(void)
+{
+	metersim_energy_t initial, expected, actual;
+	metersim_instant_t instant;
+	int32_t uptime;
+
+	metersim_createRunner(common.ctx, 0);
+	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_reset(common.ctx));
+	metersim_destroyRunner(common.ctx);
+
+	metersim_getEnergyTotal(common.ctx, &initial);
+	metersim_stepForward(common.ctx, 270);
+	metersim_getEnergyTotal(common.ctx, &expected);
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_reset(common.ctx));
+
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(0, uptime);
+	metersim_getEnergyTotal(common.ctx, &actual);
+	TEST_ASSERT_EQUAL_INT64(initial.activeMinus.value, actual.activeMinus.value);
+	TEST_ASSERT_EQUAL_INT64(initial.apparentMinus.value, actual.apparentMinus.value);
+
+	/* The scenario is replayed from the beginning */
+	metersim_stepForward(common.ctx, 270);
+	metersim_getEnergyTotal(common.ctx, &actual);
+	TEST_ASSERT_EQUAL_INT64(expected.activePlus.value, actual.activePlus.value);
+	TEST_ASSERT_EQUAL_INT64(expected.reactive[0].value, actual.reactive[0].value);
+	metersim_getInstant(common.ctx, &instant);
+	TEST_ASSERT_EQUAL_DOUBLE(300, instant.voltage[0]);
+
+}
+
+
+void testPool(void)
+{
+	metersim_pool_t *pool = metersim_poolInit(common.inputPath, 2);
+	metersim_ctx_t *a, *b;
+	metersim_energy_t expected, actual;
+	int32_t uptime;
+
+	TEST_ASSERT_NOT_NULL(pool);
+
+	a = metersim_poolAcquire(pool);
+	b = metersim_poolAcquire(pool);
+	TEST_ASSERT_NOT_NULL(a);
+	TEST_ASSERT_NOT_NULL(b);
+	TEST_ASSERT_NULL(metersim_poolAcquire(pool));
+
+	metersim_stepForward(a, 270);
+	metersim_stepForward(b, 270);
+	metersim_getEnergyTotal(a, &expected);
+	metersim_getEnergyTotal(b, &actual);
+	TEST_ASSERT_EQUAL_INT64(expected.activePlus.value, actual.activePlus.value);
+
+	/* Released instance comes back at the beginning of the scenario */
+	metersim_poolRelease(pool, a);
+	a = metersim_poolAcquire(pool);
+	TEST_ASSERT_NOT_NULL(a);
+	metersim_getUptime(a, &uptime);
+	TEST_ASSERT_EQUAL_INT32(0, uptime);
+
+	metersim_poolRelease(pool, a);
+	metersim_poolFree(pool);
+}
+
+
+void testSnapshot(void)
+{
+	metersim_snapshot_t snap;
+	metersim_instant_t instant;
+	metersim_power_t power;
+	metersim_energy_t total;
+	metersim_thd_t thd;
+
+	metersim_stepForward(common.ctx, 70);
+	metersim_getSnapshot(common.ctx, METERSIM_SNAPSHOT_ALL, &snap);
+
+	metersim_getInstant(common.ctx, &instant);
+	metersim_getPower(common.ctx, &power);
+	metersim_getEnergyTotal(common.ctx, &total);
+	metersim_getThd(common.ctx, &thd);
+
+	TEST_ASSERT_EQUAL_INT32(70, snap.timestamp);
+	TEST_ASSERT_EQUAL_UINT8(0, snap.currentTariff);
+	TEST_ASSERT_EQUAL_MEMORY(&instant, &snap.instant, sizeof(instant));
+	TEST_ASSERT_EQUAL_MEMORY(&power, &snap.power, sizeof(power));
+	TEST_ASSERT_EQUAL_MEMORY(&thd, &snap.thd, sizeof(thd));
+	TEST_ASSERT_EQUAL_INT64(total.activePlus.value, snap.energy.activePlus.value);
+	TEST_ASSERT_EQUAL_INT64(total.reactive[0].value, snap.energy.reactive[0].value);
+}
+
+
+#define READER_COUNT 4
+
+
+static struct {
+	bool done;
+	bool inconsistent;
+} readers;
+
+
+static void *readerThread(void *arg)
+{
+	metersim_ctx_t *ctx = arg;
+	metersim_energy_t total;
+	metersim_power_t power;
+	int64_t lastEnergy = 0;
+	double s2;
+
+	while (!__atomic_load_n(&readers.done, __ATOMIC_ACQUIRE)) {
+		/* Registers never decrease and a power triangle is never torn */
+		metersim_getEnergyTotal(ctx, &total);
+		if (total.activePlus.value < lastEnergy) {
+			__atomic_store_n(&readers.inconsistent, true, __ATOMIC_RELAXED);
+		}
+		lastEnergy = total.activePlus.value;
+
+		metersim_getPower(ctx, &power);
+		for (int i = 0; i < 3; i++) {
+			s2 = power.truePower[i] * power.truePower[i] + power.reactivePower[i] * power.reactivePower[i];
+			if (fabs(sqrt(s2) - power.apparentPower[i]) > 1e-6 * (1 + power.apparentPower[i])) {
+				__atomic_store_n(&readers.inconsistent, true, __ATOMIC_RELAXED);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+
+void testConcurrentReaders(void)
+{
+	pthread_t threads[READER_COUNT];
+	metersim_energy_t total;
+	int i;
+
+	readers.done = false;
+	readers.inconsistent = false;
+
+	for (i = 0; i < READER_COUNT; i++) {
+		TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, readerThread, common.ctx));
+	}
+
+	for (i = 0; i < 2000; i++) {
+		metersim_stepForward(common.ctx, 1);
+	}
+
+	__atomic_store_n(&readers.done, true, __ATOMIC_RELEASE);
+	for (i = 0; i < READER_COUNT; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	TEST_ASSERT_FALSE(readers.inconsistent);
+
+	metersim_getEnergyTotal(common.ctx, &total);
+	TEST_ASSERT_TRUE(total.activePlus.value > 0);
+}
+
+
+static struct {
+	int32_t tariffChange[4];
+	int tariffChangeCount;
+	int32_t energyCross;
+	int32_t powerAbove;
+} watched;
+
+
+static void onTariffChange(int id, int32_t time, void *arg)
+{
+	(void)id;
+	(void)arg;
+	if (watched.tariffChangeCount < 4) {
+		watched.tariffChange[watched.tariffChangeCount++] = time;
+	}
+}
+
+
+static void onWatch(int id, int32_t time, void *arg)
+{
+	(void)id;
+	*(int32_t *)arg = time;
+}
+
+
+void testWatchpoints(void)
+{
+	int id;
+
+	watched.tariffChangeCount = 0;
+	watched.energyCross = -1;
+	watched.powerAbove = -1;
+
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, metersim_addWatchpoint(common.ctx, METERSIM_WATCH_TARIFF_CHANGE, 0, onTariffChange, NULL));
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, metersim_addWatchpoint(common.ctx, METERSIM_WATCH_ENERGY_CROSS, 50000, onWatch, &watched.energyCross));
+	id = metersim_addWatchpoint(common.ctx, METERSIM_WATCH_POWER_ABOVE, 10000, onWatch, &watched.powerAbove);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, id);
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_addWatchpoint(common.ctx, -1, 0, onWatch, NULL));
+
+	metersim_stepForward(common.ctx, 100);
+
+	/* Tariff changes to 4 at 10 and back to 0 at 60 */
+	TEST_ASSERT_EQUAL_INT(2, watched.tariffChangeCount);
+	TEST_ASSERT_EQUAL_INT32(10, watched.tariffChange[0]);
+	TEST_ASSERT_EQUAL_INT32(60, watched.tariffChange[1]);
+
+	/* Import of 7752 W crosses 50000 Ws in the 7th second, between updates */
+	TEST_ASSERT_EQUAL_INT32(7, watched.energyCross);
+
+	TEST_ASSERT_EQUAL_INT32(60, watched.powerAbove);
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_removeWatchpoint(common.ctx, id));
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_removeWatchpoint(common.ctx, id));
+}
+
+
+void testWatchpointPause(void)
+{
+	metersim_clock_t *clock = metersim_clockInit();
+	metersim_runnerOpts_t opts = { .cpu = -1, .policy = METERSIM_SCHED_DEFAULT, .clock = clock };
+	int32_t uptime;
+
+	TEST_ASSERT_NOT_NULL(clock);
+	metersim_createRunnerWithOpts(common.ctx, 0, &opts);
+	metersim_setSpeedup(common.ctx, 10000);
+	metersim_addWatchpoint(common.ctx, METERSIM_WATCH_ENERGY_CROSS, 50000, NULL, NULL);
+	metersim_resume(common.ctx);
+	metersim_getUptime(common.ctx, &uptime);
+
+	/* Runner stops exactly at the crossing despite the speedup, 20 seconds of the simulation later */
+	metersim_clockAdvance(clock, 2LL * 1000 * 1000);
+	TEST_ASSERT_EQUAL_INT(0, metersim_isRunning(common.ctx));
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(7, uptime);
+
+	metersim_destroyRunner(common.ctx);
+	metersim_clockFree(clock);
+}
+
+
+static struct {
+	int32_t time[8];
+	unsigned int changed[8];
+	int count;
+} notified;
+
+
+static void onNotify(int id, unsigned int changed, int32_t time, void *arg)
+{
+	(void)id;
+	(void)arg;
+	if (notified.count < 8) {
+		notified.time[notified.count] = time;
+		notified.changed[notified.count++] = changed;
+	}
+}
+
+
+void testSubscriptions(void)
+{
+	metersim_deadband_t deadband = { .voltage = 0.2, .power = 0, .energy = 50000 };
+	uint64_t value;
+	int fds[2], id;
+
+	notified.count = 0;
+	TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+	/* A blocking descriptor could stall the simulation */
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_subscribeFd(common.ctx, METERSIM_NOTIFY_VOLTAGE, &deadband, fds[1]));
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+	id = metersim_subscribe(common.ctx, METERSIM_NOTIFY_TARIFF | METERSIM_NOTIFY_ENERGY, &deadband, onNotify, NULL);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, id);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, metersim_subscribeFd(common.ctx, METERSIM_NOTIFY_VOLTAGE, &deadband, fds[1]));
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_subscribe(common.ctx, 0, &deadband, onNotify, NULL));
+
+	/* Boundary of 50000 Ws in the 7th second like the watchpoint, tariff changes at 10 */
+	metersim_stepForward(common.ctx, 12);
+	TEST_ASSERT_EQUAL_INT(2, notified.count);
+	TEST_ASSERT_EQUAL_INT32(7, notified.time[0]);
+	TEST_ASSERT_EQUAL_UINT(METERSIM_NOTIFY_ENERGY, notified.changed[0]);
+	TEST_ASSERT_EQUAL_INT32(10, notified.time[1]);
+	TEST_ASSERT_EQUAL_UINT(METERSIM_NOTIFY_TARIFF, notified.changed[1]);
+
+	/* 240 V at 60 stays within 20% of 210 V, 270 V at 120 does not and 300 V at 180 is within 20% of it */
+	metersim_stepForward(common.ctx, 200);
+	TEST_ASSERT_EQUAL_INT(sizeof(value), read(fds[0], &value, sizeof(value)));
+	TEST_ASSERT_EQUAL_UINT64(1, value);
+	TEST_ASSERT_EQUAL_INT(-1, read(fds[0], &value, sizeof(value)));
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_unsubscribe(common.ctx, id));
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_unsubscribe(common.ctx, id));
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+
+void testSubscriptionFullPipe(void)
+{
+	metersim_deadband_t deadband = { .voltage = 0.01 };
+	uint64_t value = 1;
+	int32_t uptime;
+	int fds[2], count = 0;
+
+	TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, metersim_subscribeFd(common.ctx, METERSIM_NOTIFY_VOLTAGE, &deadband, fds[1]));
+
+	while (write(fds[1], &value, sizeof(value)) == sizeof(value)) {
+	}
+
+	/* Voltage changes at 60 while nobody reads, the simulation goes on without the notification */
+	metersim_stepForward(common.ctx, 70);
+	while (read(fds[0], &value, sizeof(value)) == sizeof(value)) {
+		count++;
+	}
+	TEST_ASSERT_GREATER_THAN_INT(0, count);
+
+	metersim_stepForward(common.ctx, 60);
+	TEST_ASSERT_EQUAL_INT(sizeof(value), read(fds[0], &value, sizeof(value)));
+
+	/* A closed reader does not kill the process with SIGPIPE */
+	close(fds[0]);
+	metersim_stepForward(common.ctx, 60);
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(190, uptime);
+
+	close(fds[1]);
+}
+
+
 void testRunner(void)
 {
 	int tariff;
 	int32_t uptime;
 	metersim_energy_t energy[3];
 	metersim_instant_t instant;
+	metersim_clock_t *clock = metersim_clockInit();
+	metersim_runnerOpts_t opts = { .cpu = -1, .policy = METERSIM_SCHED_DEFAULT, .clock = clock };
 
-	metersim_createRunner(common.ctx, 0);
+	TEST_ASSERT_NOT_NULL(clock);
+	metersim_createRunnerWithOpts(common.ctx, 0, &opts);
 	metersim_setSpeedup(common.ctx, 100);
 	metersim_pause(common.ctx, 10);
 	metersim_resume(common.ctx);
@@ -101,8 +812,8 @@ void testRunner(void)
 	metersim_getTariffCurrent(common.ctx, &tariff);
 	TEST_ASSERT_EQUAL_INT(0, tariff);
 
-	/* After this sleep the runner should be paused */
-	usleep(150 * 1000);
+	/* After 15 seconds of the simulation the runner should be paused */
+	metersim_clockAdvance(clock, 150LL * 1000 * 1000);
 
 	/* Runner should be paused at timestamp 10 */
 	metersim_getUptime(common.ctx, &uptime);
@@ -131,6 +842,236 @@ void testRunner(void)
 	TEST_ASSERT_EQUAL_DOUBLE(300, instant.voltage[0]);
 
 	metersim_destroyRunner(common.ctx);
+	metersim_clockFree(clock);
+}
+
+
+void testLazyRunner(void)
+{
+	int tariff;
+	int32_t uptime;
+	metersim_energy_t energy[3];
+	metersim_clock_t *clock = metersim_clockInit();
+
+	TEST_ASSERT_NOT_NULL(clock);
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_createLazyRunnerWithClock(common.ctx, 0, clock));
+	TEST_ASSERT_EQUAL_INT(0, metersim_isRunning(common.ctx));
+	metersim_setSpeedup(common.ctx, 100);
+	metersim_pause(common.ctx, 10);
+	metersim_resume(common.ctx);
+	TEST_ASSERT_EQUAL_INT(1, metersim_isRunning(common.ctx));
+
+	/* Nothing advances the simulation in the meantime, it catches up on the next read */
+	metersim_clockAdvance(clock, 150LL * 1000 * 1000);
+
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(10, uptime);
+	TEST_ASSERT_EQUAL_INT(0, metersim_isRunning(common.ctx));
+
+	metersim_getEnergyTariff(common.ctx, energy, 0);
+	TEST_ENERGY_REG(21000, energy[0].activePlus.value);
+	metersim_getTariffCurrent(common.ctx, &tariff);
+	TEST_ASSERT_EQUAL_INT(4, tariff);
+
+	/* Pausing watchpoints stop the catch up at the exact second */
+	metersim_setSpeedup(common.ctx, 10000);
+	metersim_addWatchpoint(common.ctx, METERSIM_WATCH_ENERGY_CROSS, 100000, NULL, NULL);
+	metersim_resume(common.ctx);
+	metersim_clockAdvance(clock, 50LL * 1000 * 1000);
+
+	TEST_ASSERT_EQUAL_INT(0, metersim_isRunning(common.ctx));
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(13, uptime);
+
+	metersim_destroyRunner(common.ctx);
+	metersim_clockFree(clock);
+}
+
+
+void testLatency(void)
+{
+	metersim_latency_t hist;
+	metersim_clock_t *clock = metersim_clockInit();
+	metersim_runnerOpts_t opts = { .cpu = -1, .policy = METERSIM_SCHED_DEFAULT, .clock = clock };
+	uint64_t total = 0;
+	int32_t uptime;
+
+	TEST_ASSERT_NOT_NULL(clock);
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_getLatency(common.ctx, METERSIM_LATENCY_WAKEUP, &hist));
+
+	metersim_createRunnerWithOpts(common.ctx, 0, &opts);
+	metersim_setSpeedup(common.ctx, 1000);
+	metersim_resume(common.ctx);
+
+	/* The thread has resumed and waits for the first update */
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(0, uptime);
+
+	/* Wakeups for the updates at 10, 60 and 120, the last one is 30 ms late */
+	metersim_clockAdvance(clock, 10LL * 1000 * 1000);
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(10, uptime);
+	metersim_clockAdvance(clock, 50LL * 1000 * 1000);
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(60, uptime);
+	metersim_clockAdvance(clock, 90LL * 1000 * 1000);
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(150, uptime);
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_getLatency(common.ctx, METERSIM_LATENCY_WAKEUP, &hist));
+	TEST_ASSERT_TRUE(hist.samples >= 3);
+	for (int i = 0; i < METERSIM_LATENCY_BUCKETS; i++) {
+		total += hist.count[i];
+	}
+	TEST_ASSERT_EQUAL_UINT64(hist.samples, total);
+	TEST_ASSERT_EQUAL_INT64(30LL * 1000 * 1000, hist.max);
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_getLatency(common.ctx, METERSIM_LATENCY_KINDS, &hist));
+
+	metersim_destroyRunner(common.ctx);
+	metersim_clockFree(clock);
+}
+
+
+void testRunnerOpts(void)
+{
+	metersim_clock_t *clock = metersim_clockInit();
+	metersim_runnerOpts_t opts = { .cpu = -1, .policy = 3, .priority = 0, .lockMemory = 0, .clock = clock };
+	metersim_latency_t wakeup, step;
+	int32_t uptime;
+
+	TEST_ASSERT_NOT_NULL(clock);
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_createRunnerWithOpts(common.ctx, 0, &opts));
+	opts.policy = METERSIM_SCHED_DEFAULT;
+	opts.cpu = -2;
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_createRunnerWithOpts(common.ctx, 0, &opts));
+	opts.cpu = -1;
+	opts.policy = METERSIM_SCHED_FIFO;
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_createRunnerWithOpts(common.ctx, 0, &opts));
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_getLatency(common.ctx, METERSIM_LATENCY_STEP, &step));
+
+	/* Binding to the first CPU does not need any privileges */
+	opts.cpu = 0;
+	opts.policy = METERSIM_SCHED_DEFAULT;
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_createRunnerWithOpts(common.ctx, 0, &opts));
+	metersim_setSpeedup(common.ctx, 1000);
+	metersim_resume(common.ctx);
+	metersim_getUptime(common.ctx, &uptime);
+	metersim_clockAdvance(clock, 10LL * 1000 * 1000);
+	metersim_getUptime(common.ctx, &uptime);
+	metersim_clockAdvance(clock, 140LL * 1000 * 1000);
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(150, uptime);
+
+	/* The step after each timed out wakeup completes no earlier than the wakeup */
+	metersim_getLatency(common.ctx, METERSIM_LATENCY_WAKEUP, &wakeup);
+	metersim_getLatency(common.ctx, METERSIM_LATENCY_STEP, &step);
+	TEST_ASSERT_TRUE(step.samples >= 2);
+	TEST_ASSERT_EQUAL_UINT64(wakeup.samples, step.samples);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT64(wakeup.sum, step.sum);
+
+	metersim_destroyRunner(common.ctx);
+	metersim_clockFree(clock);
+}
+
+
+void testManualClock(void)
+{
+	metersim_clock_t *clock = metersim_clockInit();
+	metersim_runnerOpts_t opts = { .cpu = -1, .policy = METERSIM_SCHED_DEFAULT, .clock = clock };
+	metersim_latency_t hist;
+	int32_t uptime;
+	int tariff;
+
+	TEST_ASSERT_NOT_NULL(clock);
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_createRunnerWithOpts(common.ctx, 1, &opts));
+	metersim_setSpeedup(common.ctx, 1);
+
+	/* Time stands still until the clock is advanced */
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(0, uptime);
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_clockAdvance(clock, 10LL * 1000 * 1000 * 1000));
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(10, uptime);
+	metersim_getTariffCurrent(common.ctx, &tariff);
+	TEST_ASSERT_EQUAL_INT(4, tariff);
+
+	/* The clock stopped exactly at the deadline of the update */
+	metersim_getLatency(common.ctx, METERSIM_LATENCY_STEP, &hist);
+	TEST_ASSERT_EQUAL_UINT64(1, hist.samples);
+	TEST_ASSERT_EQUAL_INT64(0, hist.max);
+
+	metersim_pause(common.ctx, 1000);
+	metersim_clockAdvance(clock, 5000LL * 1000 * 1000 * 1000);
+	TEST_ASSERT_EQUAL_INT(0, metersim_isRunning(common.ctx));
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(1000, uptime);
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_clockAdvance(clock, -1));
+
+	metersim_destroyRunner(common.ctx);
+	metersim_clockFree(clock);
+}
+
+
+void testGroupRunner(void)
+{
+	metersim_clock_t *clock = metersim_clockInit();
+	metersim_group_t *group = metersim_groupInit(1000, clock);
+	metersim_ctx_t *other = metersim_init(common.inputPath);
+	metersim_ctx_t *ahead = metersim_init(common.inputPath);
+	metersim_instant_t instant;
+	metersim_latency_t hist;
+	int32_t uptime, otherUptime;
+
+	TEST_ASSERT_NOT_NULL(clock);
+	TEST_ASSERT_NOT_NULL(group);
+	TEST_ASSERT_NOT_NULL(other);
+	TEST_ASSERT_NOT_NULL(ahead);
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_createGroupRunner(common.ctx, group));
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_createGroupRunner(other, group));
+
+	/* A simulator cannot go back to the time of the group */
+	metersim_stepForward(ahead, 100000);
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_createGroupRunner(ahead, group));
+
+	/* 300 seconds of the simulation, the group thread wakes up for each of the updates at 10, 60, 120 and 180 */
+	for (int i = 0; i < 5; i++) {
+		metersim_clockAdvance(clock, 60LL * 1000 * 1000);
+		metersim_getUptime(other, &otherUptime);
+		TEST_ASSERT_EQUAL_INT32(60 * (i + 1), otherUptime);
+	}
+
+	/* Both simulators are past the last update, woken by the thread of the group */
+	metersim_getInstant(other, &instant);
+	TEST_ASSERT_EQUAL_DOUBLE(110, instant.uiAngle[0]);
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_getLatency(other, METERSIM_LATENCY_WAKEUP, &hist));
+	TEST_ASSERT_TRUE(hist.samples >= 1);
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_groupSetSpeedup(group, 1));
+	metersim_clockAdvance(clock, 2LL * 1000 * 1000 * 1000);
+	metersim_getUptime(common.ctx, &uptime);
+	metersim_getUptime(other, &otherUptime);
+	TEST_ASSERT_EQUAL_INT32(302, uptime);
+	TEST_ASSERT_EQUAL_INT32(302, otherUptime);
+
+	/* The clock belongs to the group */
+	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_pause(other, 0));
+	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_resume(other));
+	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_setSpeedup(other, 10));
+	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_addWatchpoint(other, METERSIM_WATCH_TARIFF_CHANGE, 0, NULL, NULL));
+	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_stepForward(other, 5));
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_groupFree(group));
+	metersim_destroyRunner(common.ctx);
+	metersim_destroyRunner(other);
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_groupFree(group));
+	metersim_clockFree(clock);
+
+	metersim_free(ahead);
+	metersim_free(other);
 }
 
 
@@ -172,52 +1113,105 @@ void testUptime(void)
 
 static uint64_t timeCb(void *arg)
 {
-	(void)arg;
-	struct timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
-	return ts.tv_sec;
+	return __atomic_load_n((const uint64_t *)arg, __ATOMIC_RELAXED);
 }
 
 
 void testCustomTimeCb(void)
 {
+	uint64_t utc = 1000000;
 	int32_t uptime;
 	metersim_instant_t instant;
+	int64_t now;
 
-	metersim_createRunnerWithCb(common.ctx, timeCb, NULL);
-
-	usleep(2000 * 1000);
+	metersim_createRunnerWithCb(common.ctx, timeCb, &utc);
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(0, uptime);
 
+	/* An access wakes the thread up to poll the callback, without waiting for its period */
+	__atomic_store_n(&utc, 1000012, __ATOMIC_RELAXED);
 	metersim_getInstant(common.ctx, &instant);
+	TEST_ASSERT_EQUAL_DOUBLE(210, instant.voltage[0]);
+
+	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(12, uptime);
+	metersim_getTimeUTC(common.ctx, &now);
+	TEST_ASSERT_EQUAL_INT64(1000012, now);
+	metersim_destroyRunner(common.ctx);
+}
 
+
+void testPushedRunner(void)
+{
+	int tariff;
+	int32_t uptime;
+	int64_t next, utc;
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_createPushedRunner(common.ctx, 1000000));
+	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_stepForward(common.ctx, 5));
+
+	/* The first update after the start is at timestamp 10 */
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_advanceTime(common.ctx, 1000000, &next));
+	TEST_ASSERT_EQUAL_INT64(1000010, next);
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_advanceTime(common.ctx, 1000004, &next));
+	TEST_ASSERT_EQUAL_INT64(1000010, next);
+	metersim_getTariffCurrent(common.ctx, &tariff);
+	TEST_ASSERT_EQUAL_INT(0, tariff);
+
+	TEST_ASSERT_EQUAL_INT(METERSIM_SUCCESS, metersim_advanceTime(common.ctx, next, &next));
+	TEST_ASSERT_GREATER_THAN_INT64(1000010, next);
+	metersim_getTariffCurrent(common.ctx, &tariff);
+	TEST_ASSERT_EQUAL_INT(4, tariff);
 	metersim_getUptime(common.ctx, &uptime);
-	TEST_ASSERT_EQUAL_INT32(2, uptime);
+	TEST_ASSERT_EQUAL_INT32(10, uptime);
+	metersim_getTimeUTC(common.ctx, &utc);
+	TEST_ASSERT_EQUAL_INT64(1000010, utc);
+	metersim_getStartTimeUTC(common.ctx, &utc);
+	TEST_ASSERT_EQUAL_INT64(1000000, utc);
+
+	/* Time of the external clock never goes back */
+	TEST_ASSERT_EQUAL_INT(METERSIM_ERROR, metersim_advanceTime(common.ctx, 1000009, &next));
+
+	/* Nor can it be paused */
+	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_pause(common.ctx, 20));
+	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_addWatchpoint(common.ctx, METERSIM_WATCH_TARIFF_CHANGE, 0, NULL, NULL));
+
 	metersim_destroyRunner(common.ctx);
+
+	/* A pausing watchpoint added before would never stop the runner */
+	TEST_ASSERT_TRUE(metersim_addWatchpoint(common.ctx, METERSIM_WATCH_TARIFF_CHANGE, 0, NULL, NULL) >= 0);
+	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_createPushedRunner(common.ctx, 1000100));
 }
 
 
 void testIsRunning(void)
 {
+	metersim_clock_t *clock = metersim_clockInit();
+	metersim_runnerOpts_t opts = { .cpu = -1, .policy = METERSIM_SCHED_DEFAULT, .clock = clock };
 	int32_t uptime;
 
-	metersim_createRunner(common.ctx, 0);
+	TEST_ASSERT_NOT_NULL(clock);
+	metersim_createRunnerWithOpts(common.ctx, 0, &opts);
 	metersim_setSpeedup(common.ctx, 1000);
 	metersim_pause(common.ctx, 500);
 	metersim_resume(common.ctx);
+	metersim_getUptime(common.ctx, &uptime);
 
-	usleep(50 * 1000);
+	metersim_clockAdvance(clock, 50LL * 1000 * 1000);
 
 	/* Test whether running runner prohibits stepping forward */
 	TEST_ASSERT_EQUAL_INT(METERSIM_REFUSE, metersim_stepForward(common.ctx, 500));
 
+	/* Test isRunning function against the scheduled pause */
+	TEST_ASSERT_EQUAL_INT(1, metersim_isRunning(common.ctx));
 	metersim_getUptime(common.ctx, &uptime);
+	TEST_ASSERT_EQUAL_INT32(50, uptime);
 
-	/* Test isRunning function against the scheduled pause */
-	while (metersim_isRunning(common.ctx) == 1) {
-		TEST_ASSERT_LESS_THAN_INT32(500, uptime);
-		usleep(10 * 1000);
-		metersim_getUptime(common.ctx, &uptime);
-	}
+	metersim_clockAdvance(clock, 449LL * 1000 * 1000);
+	TEST_ASSERT_EQUAL_INT(1, metersim_isRunning(common.ctx));
+	metersim_clockAdvance(clock, 1LL * 1000 * 1000);
+	TEST_ASSERT_EQUAL_INT(0, metersim_isRunning(common.ctx));
 
 	/* Test if timestamp agrees with the scheduled pause */
 	metersim_getUptime(common.ctx, &uptime);
@@ -234,6 +1228,7 @@ void testIsRunning(void)
 	TEST_ASSERT_EQUAL_INT32(1000, uptime);
 
 	metersim_destroyRunner(common.ctx);
+	metersim_clockFree(clock);
 }
 
 
@@ -259,43 +1254,78 @@ void testMaxValues(void)
 	int32_t dt = 100 * 24 * 3600;
 	int32_t dt2 = 4 * 3600;
 	metersim_energy_t energy[3];
+	metersim_clock_t *clock = metersim_clockInit();
+	metersim_runnerOpts_t opts = { .cpu = -1, .policy = METERSIM_SCHED_DEFAULT, .clock = clock };
+	int32_t uptime;
 
 	metersim_stepForward(common.ctx, dt);
 	metersim_getEnergyTotal(common.ctx, energy);
 
 	TEST_ASSERT_EQUAL_INT64((int64_t)dt * 400 * 100 * 3, energy->apparentPlus.value);
 
-	metersim_createRunner(common.ctx, 0);
+	TEST_ASSERT_NOT_NULL(clock);
+	metersim_createRunnerWithOpts(common.ctx, 0, &opts);
 	metersim_setSpeedup(common.ctx, METERSIM_MAX_SPEEDUP);
 	metersim_pause(common.ctx, dt + dt2);
 	metersim_resume(common.ctx);
+	metersim_getUptime(common.ctx, &uptime);
 
-	while (metersim_isRunning(common.ctx)) {
-		usleep(100 * 1000);
-	}
-
-	int32_t uptime;
+	/* The whole pass to the pause is a single step of the runner */
+	metersim_clockAdvance(clock, (int64_t)dt2 * 1000 * 1000 * 1000 / METERSIM_MAX_SPEEDUP);
+	TEST_ASSERT_EQUAL_INT(0, metersim_isRunning(common.ctx));
 	metersim_getUptime(common.ctx, &uptime);
 	TEST_ASSERT_EQUAL_INT32(dt + dt2, uptime);
+
+	metersim_destroyRunner(common.ctx);
+	metersim_clockFree(clock);
 }
 
 
 int main(int argc, char **args)
 {
-	if (argc < 3) {
+	if (argc < 4) {
 		printf("Error! Please specify scenario directory.\n");
 		return 1;
 	}
 
 	strcpy(common.inputPath, args[1]);
+	strcpy(common.baselinePath, args[1]);
 
 	RUN_TEST(testStepForward);
+	RUN_TEST(testStepAndSample);
+	RUN_TEST(testDemand);
+	RUN_TEST(testPqStats);
+	RUN_TEST(testSaveState);
+	RUN_TEST(testClone);
+	RUN_TEST(testReset);
+	RUN_TEST(testPool);
+	RUN_TEST(testSnapshot);
+	RUN_TEST(testConcurrentReaders);
+	RUN_TEST(testWatchpoints);
+	RUN_TEST(testWatchpointPause);
+	RUN_TEST(testSubscriptions);
+	RUN_TEST(testSubscriptionFullPipe);
 	RUN_TEST(testRunner);
+	RUN_TEST(testLazyRunner);
+	RUN_TEST(testLatency);
+	RUN_TEST(testRunnerOpts);
+	RUN_TEST(testManualClock);
+	RUN_TEST(testGroupRunner);
 	RUN_TEST(testCustomTimeCb);
+	RUN_TEST(testPushedRunner);
 	RUN_TEST(testUptime);
 	RUN_TEST(testIsRunning);
 	RUN_TEST(testFrequentSpeedupChanges);
 
 	strcpy(common.inputPath, args[2]);
 	RUN_TEST(testMaxValues);
+
+	/* Scenario with load profile, power quality events, waveforms, pulses and history enabled */
+	strcpy(common.inputPath, args[3]);
+	RUN_TEST(testLoadProfile);
+	RUN_TEST(testLoadProfileState);
+	RUN_TEST(testPqEvents);
+	RUN_TEST(testWaveform);
+	RUN_TEST(testPulses);
+	RUN_TEST(testHistory);
 }
@@ -167,6 +167,34 @@ static void testEnergy(void)
 }
 
 
+static void testAll(void)
+{
+	struct mme_dataAll all;
+
+	if (mm_connect(common.mctx, &common.addr1, NULL) != MM_SUCCESS) {
+		printf("Unable to start simulation.\n");
+		TEST_ASSERT(0);
+		return;
+	}
+
+	usleep(100 * 1000);
+
+	TEST_ASSERT_EQUAL_INT(MM_SUCCESS, mme_getAll(common.mctx, &all));
+
+	/* From timestamp 4 there is no voltage on phase 0 and no current on phase 1 */
+	TEST_ASSERT_EQUAL_INT(0, all.tariff);
+	TEST_ASSERT_EQUAL_FLOAT(50, all.frequency);
+	TEST_ASSERT_EQUAL_FLOAT(0, all.instant.u[0]);
+	TEST_ASSERT_EQUAL_FLOAT(220, all.instant.u[1]);
+	TEST_ASSERT_EQUAL_FLOAT(0, all.power.p[0]);
+	TEST_ASSERT_EQUAL_FLOAT(0, all.power.s[1]);
+	TEST_ASSERT_EQUAL_FLOAT(11000, all.power.s[2]);
+	TEST_ASSERT_GREATER_THAN_INT64(0, all.energy.apparentPlus);
+
+	mm_disconnect(common.mctx);
+}
+
+
 int main(int argc, char **args)
 {
 	if (argc < 3) {
@@ -190,6 +218,7 @@ int main(int argc, char **args)
 	strcpy(common.inputPath, args[2]);
 	RUN_TEST(testConfig);
 	RUN_TEST(testEnergy);
+	RUN_TEST(testAll);
 
 	return EXIT_SUCCESS;
 }